@@ -0,0 +1,77 @@
+#include "ModbusBench.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+std::vector<int> ParseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        values.push_back(std::atoi(item.c_str()));
+    }
+    return values;
+}
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--port N] [--duration MS] [--threads N] [--fc 3,4,1,16] [--counts 1,10,125]"
+                      << " [--depths 1,8,32] [--connections 1,16] [--codec native|libmodbus|both]" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--port") {
+            options.port = std::atoi(value.c_str());
+        } else if (arg == "--duration") {
+            options.durationMs = std::atoi(value.c_str());
+        } else if (arg == "--threads") {
+            options.clientThreads = std::atoi(value.c_str());
+        } else if (arg == "--fc") {
+            options.functionCodes = ParseList(value);
+        } else if (arg == "--counts") {
+            options.counts = ParseList(value);
+        } else if (arg == "--depths") {
+            options.depths = ParseList(value);
+        } else if (arg == "--connections") {
+            options.connections = ParseList(value);
+        } else if (arg == "--codec") {
+            if (value == "native") {
+                options.nativeCodec = {true};
+            } else if (value == "libmodbus") {
+                options.nativeCodec = {false};
+            } else if (value == "both") {
+                options.nativeCodec = {true, false};
+            } else {
+                std::cerr << "Unknown codec: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // The server announces itself on std::cout; keep stdout for the JSON.
+    std::ostream json(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+    try {
+        ModbusBench bench(options);
+        std::vector<BenchResult> results = bench.Run();
+        json << "[" << std::endl;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            json << "  " << results[i].ToJson() << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        json << "]" << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Benchmark error: " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
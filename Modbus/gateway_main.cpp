@@ -0,0 +1,72 @@
+#include "ModbusGateway.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+ModbusGateway* g_gateway = nullptr;
+
+void OnSignal(int) {
+    // Stop() only stores a flag and writes an eventfd, both async-signal-safe.
+    if (g_gateway) {
+        g_gateway->Stop();
+    }
+}
+}
+
+int main(int argc, char* argv[]) {
+    int port = 5020;
+    GatewayOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--port N] [--device HOST:PORT] [--unit N] [--connections N] [--depth N]"
+                      << " [--timeout MS] [--window MS] [--gap N]" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--port") {
+            port = std::atoi(value.c_str());
+        } else if (arg == "--device") {
+            std::size_t colon = value.rfind(':');
+            options.deviceAddress = value.substr(0, colon);
+            if (colon != std::string::npos) {
+                options.devicePort = std::atoi(value.c_str() + colon + 1);
+            }
+        } else if (arg == "--unit") {
+            options.unitId = static_cast<uint8_t>(std::atoi(value.c_str()));
+        } else if (arg == "--connections") {
+            options.connections = static_cast<std::size_t>(std::atoi(value.c_str()));
+        } else if (arg == "--depth") {
+            options.pipelineDepth = static_cast<std::size_t>(std::atoi(value.c_str()));
+        } else if (arg == "--timeout") {
+            options.timeoutMs = std::atoi(value.c_str());
+        } else if (arg == "--window") {
+            options.windowMs = std::atoi(value.c_str());
+        } else if (arg == "--gap") {
+            options.maxGap = std::atoi(value.c_str());
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        ModbusGateway gateway("0.0.0.0", port, options);
+        g_gateway = &gateway;
+        std::signal(SIGINT, OnSignal);
+        std::signal(SIGTERM, OnSignal);
+        gateway.Run();
+        g_gateway = nullptr;
+
+        GatewayStats stats = gateway.Stats();
+        std::cout << stats.requests << " requests, " << stats.deviceRequests << " sent to the device, "
+                  << stats.mergedReads << " reads merged" << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Gateway error: " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#ifndef ASYNC_MODBUS_CLIENT_HPP
+#define ASYNC_MODBUS_CLIENT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+#include "ModbusCodec.hpp"
+
+enum class TransactionStatus {
+    Ok,
+    Exception,      // the device answered with a Modbus exception; pdu[1] is the code
+    Timeout,
+    Disconnected
+};
+
+// Modbus TCP client that keeps up to `pipelineDepth` requests outstanding on
+// one connection and matches replies to requests by transaction identifier,
+// so throughput no longer stops at one request per round trip.
+//
+// The client is not thread-safe and never blocks; even the connection is
+// established in the background, and requests wait until it is up. Either
+// drive it from an event loop (Fd(), WantsWrite(), OnReadable(),
+// OnWritable(), CheckTimeouts()) or call Poll()/Drain(), which do the same
+// with poll(2). Callbacks run inside those calls; they may submit further
+// requests but must not call Poll() or Drain().
+class AsyncModbusClient {
+public:
+    static constexpr std::size_t kMaxPduLength = ModbusCodec::kMaxPduLength;
+    static constexpr int kMaxReadRegisters = 125;
+    static constexpr int kMaxReadBits = 2000;
+
+    // Called with the reply PDU (function code first); pdu is null unless
+    // status is Ok or Exception.
+    using PduCallback = std::function<void(TransactionStatus status, const uint8_t* pdu, std::size_t length)>;
+    using RegistersCallback = std::function<void(TransactionStatus status, const uint16_t* values, std::size_t count)>;
+    // Bits arrive unpacked, one 0/1 byte each.
+    using BitsCallback = std::function<void(TransactionStatus status, const uint8_t* bits, std::size_t count)>;
+
+    AsyncModbusClient(const char* address, int port, std::size_t pipelineDepth = 8, int timeoutMs = 1000,
+                      uint8_t unitId = 1);
+    ~AsyncModbusClient();
+
+    AsyncModbusClient(const AsyncModbusClient&) = delete;
+    AsyncModbusClient& operator=(const AsyncModbusClient&) = delete;
+
+    // Sends any PDU. Requests beyond the pipeline depth wait in a queue.
+    void Transact(const uint8_t* pdu, std::size_t length, PduCallback callback);
+
+    void ReadHoldingRegisters(int start, int count, RegistersCallback callback);
+    void ReadInputRegisters(int start, int count, RegistersCallback callback);
+    void ReadCoils(int start, int count, BitsCallback callback);
+    void ReadDiscreteInputs(int start, int count, BitsCallback callback);
+    void WriteRegisters(int start, const uint16_t* values, int count, PduCallback callback);
+
+    // The future is fulfilled by a later Poll()/Drain() or event-loop call.
+    std::future<std::vector<uint16_t>> ReadHoldingRegisters(int start, int count);
+
+    // Drops the connection and fails everything outstanding with Disconnected.
+    void Close();
+    // Starts connecting again after Close() or a failure. Like the
+    // constructor, throws only if the address does not resolve or the
+    // connection is refused at once; a slower failure shows up as
+    // Disconnected on the queued requests.
+    void Reconnect();
+
+    // True while connected or connecting.
+    [[nodiscard]] bool Connected() const;
+    [[nodiscard]] bool Connecting() const;
+    [[nodiscard]] int Fd() const;
+    [[nodiscard]] bool WantsWrite() const;
+    [[nodiscard]] std::size_t InFlight() const;
+    [[nodiscard]] std::size_t Queued() const;
+
+    void OnReadable();
+    void OnWritable();
+    void CheckTimeouts(int64_t nowMs);
+
+    // Waits up to timeoutMs for socket activity and handles it. Returns true
+    // while requests are still outstanding.
+    bool Poll(int timeoutMs);
+    // Polls until every submitted request has completed or failed.
+    void Drain();
+
+    static int64_t NowMs();
+
+private:
+    struct Request {
+        std::size_t length;
+        std::array<uint8_t, kMaxPduLength> pdu;
+        PduCallback callback;
+    };
+
+    struct Transaction {
+        uint16_t id;
+        int64_t deadlineMs;
+        PduCallback callback;
+    };
+
+    std::string address_;
+    int port_;
+    int fd_;
+    uint32_t generation_;                    // bumped by Close(), so parsing stops if a callback reconnects
+    bool connecting_;
+    int64_t connectDeadlineMs_;
+    std::size_t pipelineDepth_;
+    int timeoutMs_;
+    uint8_t unitId_;
+    uint16_t nextId_;
+    std::deque<Request> queued_;
+    std::deque<Transaction> inFlight_;       // in send order; replies usually arrive in it too
+    std::vector<uint8_t> output_;            // encoded frames not yet accepted by the socket
+    std::size_t inputLength_;
+    std::array<uint8_t, 4 * ModbusCodec::kMaxAduLength> input_;
+    std::vector<uint16_t> values_;           // scratch for decoded register replies
+    std::vector<uint8_t> bits_;              // scratch for unpacked bit replies
+
+    void Connect();
+    void SendQueued();
+    void Encode(const uint8_t* pdu, std::size_t length, PduCallback callback, int64_t deadlineMs);
+    void Flush();
+    void Complete(uint16_t id, const uint8_t* pdu, std::size_t length);
+    void ReadRegisters(uint8_t functionCode, int start, int count, RegistersCallback callback);
+    void ReadBits(uint8_t functionCode, int start, int count, BitsCallback callback);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef HISTORIAN_HPP
+#define HISTORIAN_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct HistorySample {
+    int64_t timestampMs;
+    double value;
+};
+
+struct HistoryBucket {
+    int64_t startMs;
+    uint32_t count;
+    double min;
+    double max;
+    double mean;
+    double last;
+};
+
+// In-memory time series for polled values, one series per tag.
+//
+// Samples are packed into fixed-size blocks: timestamps as delta-of-delta,
+// values as the XOR with the previous value, so a register polled at a
+// steady rate that does not change costs two bits per sample.
+//
+// Each tag has a single writer (the thread that polls it); any number of
+// threads may query concurrently. Readers decode the bits a block has
+// published so far and never take a lock, so queries do not hold up
+// ingestion. Blocks older than the retention are released once no query
+// is running.
+class Historian {
+public:
+    static constexpr std::size_t kBlockBytes = 1024;
+
+    // retentionMs == 0 keeps everything.
+    explicit Historian(std::size_t tags, int64_t retentionMs = 0);
+    ~Historian();
+
+    Historian(const Historian&) = delete;
+    Historian& operator=(const Historian&) = delete;
+
+    // Returns false for a timestamp older than the tag's last sample.
+    bool Append(std::size_t tag, int64_t timestampMs, double value);
+    // Appends values[i] to tag firstTag + i; fits a PollEngine group callback.
+    void AppendPoll(std::size_t firstTag, int64_t timestampMs, const uint16_t* values, std::size_t count);
+
+    // Samples with fromMs <= timestamp < toMs, oldest first.
+    [[nodiscard]] std::vector<HistorySample> Range(std::size_t tag, int64_t fromMs, int64_t toMs) const;
+    // One bucket per stepMs from fromMs; empty buckets are left out.
+    [[nodiscard]] std::vector<HistoryBucket> Downsample(std::size_t tag, int64_t fromMs, int64_t toMs,
+                                                        int64_t stepMs) const;
+
+    [[nodiscard]] std::size_t TagCount() const;
+    [[nodiscard]] uint64_t SampleCount() const;
+    [[nodiscard]] std::size_t MemoryBytes() const;
+
+private:
+    static constexpr std::size_t kWords = (kBlockBytes - 32) / 8;
+
+    struct Block {
+        int64_t firstTimestampMs = 0;
+        std::atomic<uint32_t> count{0};            // samples published to readers
+        std::atomic<Block*> next{nullptr};
+        std::atomic<uint64_t> words[kWords] = {};  // bit stream, most significant bit first
+    };
+
+    // Decoder state, also kept by the writer to encode the next sample.
+    struct Cursor {
+        uint32_t bit = 0;
+        int64_t timestampMs = 0;
+        int64_t deltaMs = 0;
+        uint64_t valueBits = 0;
+        unsigned leading = 0;
+        unsigned trailing = 0;
+    };
+
+    struct Series {
+        std::atomic<Block*> head{nullptr};         // oldest block still reachable
+        Block* tail = nullptr;
+        Cursor writer;
+        std::vector<Block*> retired;               // unlinked, waiting for readers to finish
+    };
+
+    std::vector<Series> series_;
+    int64_t retentionMs_;
+    std::atomic<uint64_t> samples_;
+    std::atomic<std::size_t> blocks_;
+    mutable std::atomic<uint32_t> readers_;
+
+    void StartBlock(Series& series, int64_t timestampMs);
+    void Retire(Series& series, int64_t nowMs);
+
+    static void Put(Block& block, uint32_t& bit, uint64_t value, unsigned width);
+    static uint64_t Get(const Block& block, uint32_t& bit, unsigned width);
+    static void Encode(Block& block, Cursor& cursor, int64_t timestampMs, uint64_t valueBits);
+    static void Decode(const Block& block, Cursor& cursor, bool first);
+
+    template <typename Visit>
+    void Scan(std::size_t tag, int64_t fromMs, int64_t toMs, Visit visit) const;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MODBUS_BENCH_HPP
+#define MODBUS_BENCH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    int port = 5502;
+    int durationMs = 2000;       // per case
+    int clientThreads = 2;
+    std::vector<int> functionCodes{3};
+    std::vector<int> counts{1, 10, 125};
+    std::vector<int> depths{1, 8, 32};
+    std::vector<int> connections{1, 16};
+    std::vector<bool> nativeCodec{true};
+};
+
+struct BenchResult {
+    bool nativeCodec;
+    int functionCode;
+    int count;
+    int depth;
+    int connections;
+    uint64_t requests;
+    uint64_t errors;
+    double seconds;
+    double requestsPerSecond;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t p999Us;
+    uint32_t maxUs;
+
+    [[nodiscard]] std::string ToJson() const;
+};
+
+// Runs a ModbusServer and pipelined AsyncModbusClient connections over
+// loopback for every combination of the option lists, one case at a time.
+// Each connection keeps `depth` requests in flight; latency is measured
+// from submission to completion.
+class ModbusBench {
+public:
+    explicit ModbusBench(BenchOptions options);
+
+    std::vector<BenchResult> Run();
+
+private:
+    BenchOptions options_;
+
+    BenchResult RunCase(bool nativeCodec, int functionCode, int count, int depth, int connections);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MODBUS_CODEC_HPP
+#define MODBUS_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "RegisterMap.hpp"
+
+// Modbus TCP framing and request handling that works directly on socket
+// buffers: frames are parsed in place and replies are encoded straight into
+// the caller's output buffer, with no allocation and no intermediate copy.
+// Function codes outside the native set (see Handles()) are left to
+// libmodbus.
+class ModbusCodec {
+public:
+    static constexpr std::size_t kMbapHeaderLength = 7;
+    static constexpr std::size_t kMaxPduLength = 253;
+    static constexpr std::size_t kMaxAduLength = kMbapHeaderLength + kMaxPduLength;
+
+    // Points into the buffer given to Parse().
+    struct Frame {
+        uint16_t transactionId;
+        uint8_t unitId;
+        const uint8_t* pdu;
+        std::size_t pduLength;
+        std::size_t size;        // whole ADU, header included
+    };
+
+    enum class ParseResult {
+        Complete,
+        Incomplete,
+        Invalid       // not Modbus TCP; the stream cannot be resynchronized
+    };
+
+    static ParseResult Parse(const uint8_t* data, std::size_t length, Frame& frame);
+    static void WriteHeader(uint8_t* out, uint16_t transactionId, uint8_t unitId, std::size_t pduLength);
+
+    // True for the function codes Serve() answers itself.
+    static bool Handles(uint8_t functionCode);
+    // Answers a request PDU against `registers`, writing the reply PDU
+    // (possibly an exception) to `out`, which must hold kMaxPduLength bytes.
+    // Returns the reply length.
+    static std::size_t Serve(RegisterMap& registers, const uint8_t* pdu, std::size_t length, uint8_t* out);
+
+    static uint16_t ReadU16(const uint8_t* data) {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    static void WriteU16(uint8_t* data, uint16_t value) {
+        data[0] = static_cast<uint8_t>(value >> 8);
+        data[1] = static_cast<uint8_t>(value & 0xFF);
+    }
+};
+
+#endif
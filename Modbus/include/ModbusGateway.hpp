@@ -0,0 +1,158 @@
+#ifndef MODBUS_GATEWAY_HPP
+#define MODBUS_GATEWAY_HPP
+
+#include <modbus/modbus.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AsyncModbusClient.hpp"
+#include "ModbusCodec.hpp"
+
+struct GatewayOptions {
+    std::string deviceAddress = "127.0.0.1";
+    int devicePort = 502;
+    uint8_t unitId = 1;              // of the device; the only unit the gateway serves
+    std::size_t connections = 1;     // to the device; many accept only one or two
+    std::size_t pipelineDepth = 1;   // per device connection
+    int timeoutMs = 1000;
+    int64_t windowMs = 5;            // how long a read waits for others to merge with
+    int maxGap = 8;                  // unrequested addresses a merged read may span
+};
+
+struct GatewayStats {
+    uint64_t requests;               // from front-end clients
+    uint64_t deviceRequests;         // sent to the device
+    uint64_t mergedReads;            // front-end reads answered from a shared device read
+};
+
+// Modbus TCP gateway: accepts any number of clients like ModbusServer and
+// forwards their requests to one device over a small pool of pipelined
+// AsyncModbusClient connections.
+//
+// Reads (function codes 1-4) are held for windowMs, and after that for as
+// long as the device connections are busy. Identical reads are sent once,
+// and reads of the same table that overlap or lie within maxGap of each
+// other are merged into one device read, up to the protocol limit. Each
+// requester gets its own slice, under its own transaction ID and unit ID,
+// and replies on a connection stay in request order. If the device rejects
+// a merged read, each distinct range is retried on its own, so a gap that
+// covers unmapped addresses does not fail the reads around it. Writes and
+// other function codes go straight through, after the reads queued before
+// them. With more than one device connection, a client's write is held
+// until its earlier requests have been answered, and its later requests
+// until the write has, so the device sees each client's writes in order
+// with its reads.
+//
+// The gateway fronts a single device: requests must address
+// GatewayOptions::unitId, or 0xFF, which Modbus TCP clients use for "the
+// device at this address". Any other unit ID is answered with exception
+// 0x0A rather than passed on to the wrong unit. Device failures come back
+// as exception 0x0A (no device connection) or 0x0B (the device did not
+// answer).
+class ModbusGateway {
+public:
+    ModbusGateway(const char* address, int port, GatewayOptions options);
+    ~ModbusGateway();
+
+    ModbusGateway(const ModbusGateway&) = delete;
+    ModbusGateway& operator=(const ModbusGateway&) = delete;
+
+    void Run();
+    // Safe to call from any thread; Run() returns after its current pass.
+    void Stop();
+
+    [[nodiscard]] std::size_t ConnectionCount() const;
+    // Safe to call from any thread.
+    [[nodiscard]] GatewayStats Stats() const;
+
+private:
+    struct Reply {
+        uint16_t transactionId;
+        uint8_t unitId;
+        bool done = false;
+        std::size_t length = 0;
+        std::array<uint8_t, ModbusCodec::kMaxPduLength> pdu;
+    };
+
+    struct Connection {
+        bool open = false;
+        uint32_t generation = 0;     // bumped on close, so late replies for an old client are dropped
+        uint32_t events = 0;         // current epoll interest
+        bool dirty = false;          // has finished replies to send
+        std::size_t length = 0;      // bytes buffered in input
+        uint8_t input[4 * ModbusCodec::kMaxAduLength];
+        std::deque<Reply> replies;   // in request order
+        uint64_t firstSequence = 0;  // sequence number of replies.front()
+        bool blocked = false;        // next request waits for earlier ones to be answered
+        bool writePending = false;   // a write is at the device; later requests wait for it
+        uint64_t writeSequence = 0;
+        std::vector<uint8_t> output;
+    };
+
+    // Where a device reply has to go.
+    struct Waiter {
+        int fd;
+        uint32_t generation;
+        uint64_t sequence;
+    };
+
+    struct PendingRead {
+        uint16_t start;
+        uint16_t count;
+        Waiter waiter;
+    };
+
+    struct Backend {
+        std::unique_ptr<AsyncModbusClient> client;
+        int registeredFd = -1;
+        bool watchingWrite = false;
+        int64_t reconnectAtMs = 0;
+        int64_t backoffMs = 0;
+    };
+
+    GatewayOptions options_;
+    modbus_t* ctx_;
+    int serverSocket_;
+    int port_;
+    int epollFd_;
+    int wakeFd_;
+    std::atomic<bool> running_;
+    std::vector<std::unique_ptr<Connection>> connections_;   // indexed by fd
+    std::size_t openCount_;
+    std::vector<Backend> backends_;
+    std::array<std::vector<PendingRead>, 4> pending_;          // by read function code - 1
+    int64_t windowEndsMs_;                                     // -1 while no read is pending
+    std::vector<int> dirty_;
+    std::atomic<uint64_t> requests_;
+    std::atomic<uint64_t> deviceRequests_;
+    std::atomic<uint64_t> mergedReads_;
+
+    void AcceptAll();
+    void OnReadable(int fd);
+    void OnWritable(int fd);
+    bool ServeFrames(int fd, Connection& conn);
+    bool MustWait(const Connection& conn, const ModbusCodec::Frame& frame) const;
+    bool Flush(int fd, Connection& conn);
+    void UpdateEvents(int fd, Connection& conn);
+    void SendReplies();
+    void CloseConnection(int fd);
+
+    void Dispatch(const uint8_t* pdu, std::size_t length, const Waiter& waiter, int64_t nowMs);
+    void Forward(const uint8_t* pdu, std::size_t length, const Waiter& waiter);
+    void FlushReads();
+    void ReadSpan(uint8_t functionCode, uint16_t start, uint16_t count, std::vector<PendingRead> members,
+                  bool split);
+    void Complete(const Waiter& waiter, const uint8_t* pdu, std::size_t length);
+    void Fail(const Waiter& waiter, uint8_t functionCode, uint8_t exceptionCode);
+    AsyncModbusClient* PickBackend();
+    bool DeviceReady();
+    void Maintain(int64_t nowMs);
+    void Watch(std::size_t backend);
+};
+
+#endif
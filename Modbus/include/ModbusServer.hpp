@@ -2,20 +2,71 @@
 #define MODBUS_SERVER_HPP
 
 #include <modbus/modbus.h>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <vector>
+#include "ModbusCodec.hpp"
+#include "RegisterMap.hpp"
 
+// Modbus TCP server driven by one epoll loop. Clients keep their connections
+// open and may send any number of requests, pipelined or not; each request
+// is answered in order on the connection it arrived on. Values come from a
+// RegisterMap that other threads may update while the server runs.
+//
+// The common function codes are answered by ModbusCodec straight from the
+// register map, and the replies to everything that arrived in one read go
+// out in a single send. Other function codes fall back to modbus_reply().
 class ModbusServer {
 public:
-    ModbusServer(const char* address, int port);
+    // Without a register map the server creates its own, with holding
+    // registers 0-9 set to 10, 20, ..., 100.
+    ModbusServer(const char* address, int port, std::shared_ptr<RegisterMap> registers = nullptr);
     ~ModbusServer();
 
+    ModbusServer(const ModbusServer&) = delete;
+    ModbusServer& operator=(const ModbusServer&) = delete;
+
     void Run();
+    // Safe to call from any thread; Run() returns after its current pass.
+    void Stop();
+
+    [[nodiscard]] std::size_t ConnectionCount() const;
+    [[nodiscard]] uint64_t RequestCount() const;
+    [[nodiscard]] RegisterMap& Registers();
+    // Routes every request through libmodbus when false, for comparison.
+    void UseNativeCodec(bool enabled);
 
 private:
+    struct Connection {
+        bool open = false;
+        bool writing = false;        // waiting for EPOLLOUT; input is not read meanwhile
+        std::size_t length = 0;      // bytes buffered in input
+        uint8_t input[4 * MODBUS_TCP_MAX_ADU_LENGTH];
+        std::vector<uint8_t> output; // encoded replies the socket has not taken yet
+    };
+
     modbus_t* ctx_;
-    modbus_mapping_t* mapping_;
+    modbus_mapping_t* mapping_;      // staging copy that modbus_reply() reads and writes
+    std::shared_ptr<RegisterMap> registers_;
     int serverSocket_;
+    int port_;
+    int epollFd_;
+    int wakeFd_;
+    std::atomic<bool> running_;
+    std::vector<std::unique_ptr<Connection>> connections_;   // indexed by fd
+    std::size_t openCount_;
+    uint64_t requests_;
+    bool nativeCodec_;
+
+    void AcceptAll();
+    void OnReadable(int fd);
+    void OnWritable(int fd);
+    bool ServeFrames(int fd, Connection& conn);
+    bool Flush(int fd, Connection& conn);
+    void StageRequest(const uint8_t* pdu);
+    void CommitRequest(const uint8_t* pdu);
+    void CloseConnection(int fd);
 };
 
 #endif
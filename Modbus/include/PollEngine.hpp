@@ -0,0 +1,108 @@
+#ifndef POLL_ENGINE_HPP
+#define POLL_ENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AsyncModbusClient.hpp"
+#include "ReadPlan.hpp"
+
+struct PollGroupStats {
+    uint64_t cycles;
+    uint64_t failures;       // cycles that ended in a timeout, exception or disconnect
+    uint64_t overruns;       // cycles skipped because the previous one was still running
+    uint32_t lastCycleMs;
+    uint32_t maxCycleMs;
+};
+
+// Polls many devices from a fixed number of I/O threads. Every device has
+// one pipelined connection, owned by one thread, that is re-established
+// with backoff when it fails. Poll groups (a ReadPlan run every periodMs on
+// one device) are scheduled on each thread's timer wheel; groups are
+// offset by a hash of their id so that groups sharing a period do not all
+// fire on the same tick.
+//
+// Add devices and groups before Start(). Callbacks run on the I/O thread
+// that owns the device and should hand their data off quickly.
+class PollEngine {
+public:
+    using GroupCallback = std::function<void(TransactionStatus status, const uint16_t* values, std::size_t count)>;
+
+    static constexpr int64_t kTickMs = 10;
+    static constexpr std::size_t kWheelSlots = 1024;
+
+    explicit PollEngine(std::size_t threads);
+    ~PollEngine();
+
+    PollEngine(const PollEngine&) = delete;
+    PollEngine& operator=(const PollEngine&) = delete;
+
+    std::size_t AddDevice(const char* address, int port, uint8_t unitId = 1, std::size_t pipelineDepth = 4,
+                          int timeoutMs = 1000);
+    std::size_t AddGroup(std::size_t device, std::shared_ptr<const ReadPlan> plan, int64_t periodMs,
+                         GroupCallback callback);
+
+    void Start();
+    void Stop();
+
+    // Safe to call from any thread while the engine runs.
+    [[nodiscard]] PollGroupStats Stats(std::size_t group) const;
+
+private:
+    struct Device {
+        std::string address;
+        int port;
+        uint8_t unitId;
+        std::size_t pipelineDepth;
+        int timeoutMs;
+        std::unique_ptr<AsyncModbusClient> client;
+        int registeredFd = -1;
+        bool watchingWrite = false;
+        int64_t reconnectAtMs = 0;
+        int64_t backoffMs = 0;
+    };
+
+    struct Group {
+        std::size_t device;
+        std::shared_ptr<const ReadPlan> plan;
+        int64_t periodMs;
+        GroupCallback callback;
+        std::vector<uint16_t> values;
+        int64_t dueMs = 0;
+        int64_t startedMs = 0;
+        bool running = false;
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> overruns{0};
+        std::atomic<uint32_t> lastCycleMs{0};
+        std::atomic<uint32_t> maxCycleMs{0};
+    };
+
+    struct Worker {
+        int epollFd = -1;
+        int wakeFd = -1;
+        std::vector<std::size_t> devices;
+        std::vector<std::vector<std::size_t>> wheel;   // group ids by due tick
+        int64_t tick = 0;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Device>> devices_;
+    std::vector<std::unique_ptr<Group>> groups_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_;
+
+    void Run(Worker& worker);
+    void Schedule(Worker& worker, std::size_t group);
+    void RunDue(Worker& worker, int64_t nowMs);
+    void StartCycle(std::size_t group, int64_t nowMs);
+    void Maintain(Worker& worker, int64_t nowMs);
+    void Watch(Worker& worker, std::size_t device);
+};
+
+#endif
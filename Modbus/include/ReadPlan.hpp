@@ -0,0 +1,67 @@
+#ifndef READ_PLAN_HPP
+#define READ_PLAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "AsyncModbusClient.hpp"
+#include "RegisterMap.hpp"
+
+// One polled value: `width` consecutive entries starting at `address`
+// (2 for a 32-bit value spread over two registers, for example).
+struct Tag {
+    RegisterTable table;
+    uint16_t address;
+    uint16_t width = 1;
+};
+
+struct ReadBlock {
+    RegisterTable table;
+    uint16_t start;
+    uint16_t count;
+};
+
+// Coalesces a tag list into the fewest protocol-legal block reads: tags of
+// the same table whose addresses are at most `maxGap` apart share a block,
+// up to 125 registers or 2000 bits per block. Build the plan once and run
+// it every poll cycle.
+//
+// Results are scattered into a flat value array in which tag i occupies
+// ValueOffset(i) .. ValueOffset(i) + width - 1. Bits are stored as 0 or 1.
+class ReadPlan {
+public:
+    ReadPlan(const std::vector<Tag>& tags, uint16_t maxGap);
+
+    [[nodiscard]] const std::vector<ReadBlock>& Blocks() const;
+    [[nodiscard]] std::size_t TagCount() const;
+    [[nodiscard]] std::size_t ValueCount() const;
+    [[nodiscard]] std::size_t ValueOffset(std::size_t tag) const;
+
+    // Copies the reply to Blocks()[block] into the values of its tags.
+    void Scatter(std::size_t block, const uint16_t* data, uint16_t* values) const;
+    void Scatter(std::size_t block, const uint8_t* bits, uint16_t* values) const;
+
+    // Issues every block read and calls `done` once all have finished, with
+    // Ok or the first failure. `values` must stay valid until then; values of
+    // failed blocks are left untouched.
+    void Submit(AsyncModbusClient& client, uint16_t* values, std::function<void(TransactionStatus)> done) const;
+
+private:
+    struct Slot {
+        uint16_t offset;        // of the tag's first entry within its block
+        uint16_t width;
+        uint32_t value;         // index into the caller's value array
+    };
+
+    std::vector<ReadBlock> blocks_;
+    std::vector<uint32_t> firstSlot_;       // blocks_.size() + 1 entries
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> valueOffsets_;    // per tag, in the order given
+    std::size_t valueCount_;
+
+    template <typename T>
+    void ScatterBlock(std::size_t block, const T* data, uint16_t* values) const;
+};
+
+#endif
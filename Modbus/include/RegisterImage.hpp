@@ -0,0 +1,82 @@
+#ifndef REGISTER_IMAGE_HPP
+#define REGISTER_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Client-side copy of a device's values that polls update in place.
+// Update() compares each poll result against the image (eight or sixteen
+// registers per instruction where SSE2/AVX2 are available) and only
+// subscribers whose range changed by more than their deadband hear about it,
+// so downstream work follows the change rate rather than the poll rate.
+//
+// Indices are whatever the caller polls into: register addresses, or the
+// value offsets of a ReadPlan when fed from a PollEngine group. Every index
+// counts as changed the first time it is written. Not thread-safe; update
+// and subscribe from the thread that polls. Callbacks may subscribe and
+// unsubscribe (themselves included) but must not call Update(); a
+// subscription made during a callback first hears about the next Update().
+class RegisterImage {
+public:
+    // `values` points into the image at `index`; it holds `count` entries,
+    // from the first to the last entry of the subscription that moved past
+    // its deadband.
+    using ChangeCallback = std::function<void(std::size_t index, const uint16_t* values, std::size_t count)>;
+
+    explicit RegisterImage(std::size_t size);
+
+    // Calls back when any entry in [index, index + count) differs from the
+    // value last reported to this subscriber by more than `deadband`. The
+    // first call after subscribing reports the whole changed span; read
+    // Values() for the current state.
+    std::size_t Subscribe(std::size_t index, std::size_t count, uint16_t deadband, ChangeCallback callback);
+    void Unsubscribe(std::size_t subscription);
+
+    // Stores a poll result and notifies subscribers. Returns how many
+    // entries changed.
+    std::size_t Update(std::size_t index, const uint16_t* values, std::size_t count);
+
+    [[nodiscard]] const uint16_t* Values() const;
+    [[nodiscard]] std::size_t Size() const;
+
+private:
+    static constexpr std::size_t kBucketSize = 64;
+
+    struct Range {
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    struct Subscription {
+        std::size_t index;
+        std::size_t count;
+        uint16_t deadband;
+        bool active;
+        bool primed;             // reported is valid
+        uint64_t stamp;          // last Update() that visited this subscription
+        std::vector<uint16_t> reported;
+        ChangeCallback callback;
+    };
+
+    std::vector<uint16_t> values_;
+    std::vector<uint64_t> unseen_;                  // bit per entry never written
+    std::size_t unseenCount_;
+    std::vector<Subscription> subscriptions_;
+    std::vector<Subscription> added_;               // subscribed while notifying, IDs after subscriptions_
+    bool notifying_;
+    std::size_t running_;                           // subscription whose callback is running
+    std::vector<std::vector<uint32_t>> buckets_;   // subscriptions overlapping each kBucketSize entries
+    std::vector<Range> changed_;
+    std::vector<uint32_t> touched_;
+    uint64_t stamp_;
+
+    void FindChanges(std::size_t index, const uint16_t* values, std::size_t count);
+    void MarkChanged(std::size_t at);
+    bool TakeUnseen(std::size_t index, std::size_t count);
+    void AddToBuckets(std::size_t id);
+    void Notify(std::size_t id);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef REGISTER_MAP_HPP
+#define REGISTER_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+enum class RegisterTable : uint8_t {
+    Coils,
+    DiscreteInputs,
+    HoldingRegisters,
+    InputRegisters
+};
+
+// The four Modbus data tables at full protocol size (65536 entries each),
+// shared between the server and whatever produces the values: a
+// simulation, a field-I/O thread or the clients' own write requests.
+//
+// Each table is split into stripes guarded by sequence counters. A writer
+// bumps the counters of every stripe it touches to odd, stores, and bumps
+// them back to even; a reader copies its range and retries if any of those
+// counters was odd or moved. Reads of up to 125 registers therefore see a
+// single write either completely or not at all, and never block a writer.
+class RegisterMap {
+public:
+    static constexpr std::size_t kTableSize = 65536;
+    static constexpr std::size_t kStripeSize = 128;
+
+    RegisterMap();
+
+    RegisterMap(const RegisterMap&) = delete;
+    RegisterMap& operator=(const RegisterMap&) = delete;
+
+    // Writers are serialized per table. Ranges past the end are clipped.
+    void WriteRegisters(RegisterTable table, uint16_t address, const uint16_t* values, std::size_t count);
+    void WriteBits(RegisterTable table, uint16_t address, const uint8_t* values, std::size_t count);
+
+    // Consistent snapshot of [address, address + count); bits are 0 or 1.
+    void ReadRegisters(RegisterTable table, uint16_t address, uint16_t* out, std::size_t count) const;
+    void ReadBits(RegisterTable table, uint16_t address, uint8_t* out, std::size_t count) const;
+
+private:
+    static constexpr std::size_t kStripes = kTableSize / kStripeSize;
+
+    struct Table {
+        std::unique_ptr<std::atomic<uint16_t>[]> values;
+        std::unique_ptr<std::atomic<uint32_t>[]> stripes;   // odd while a write is in progress
+        std::mutex writeMutex;
+    };
+
+    Table tables_[4];
+
+    template <typename T>
+    void Write(RegisterTable table, uint16_t address, const T* values, std::size_t count);
+    template <typename T>
+    void Read(RegisterTable table, uint16_t address, T* out, std::size_t count) const;
+};
+
+#endif
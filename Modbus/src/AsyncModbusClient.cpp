@@ -0,0 +1,394 @@
+#include "AsyncModbusClient.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+constexpr uint8_t kReadCoils = 0x01;
+constexpr uint8_t kReadDiscreteInputs = 0x02;
+constexpr uint8_t kReadHoldingRegisters = 0x03;
+constexpr uint8_t kReadInputRegisters = 0x04;
+constexpr uint8_t kWriteMultipleRegisters = 0x10;
+constexpr int kMaxWriteRegisters = 123;
+}
+
+AsyncModbusClient::AsyncModbusClient(const char* address, int port, std::size_t pipelineDepth, int timeoutMs,
+                                     uint8_t unitId)
+    : address_(address), port_(port), fd_(-1), generation_(0), connecting_(false), connectDeadlineMs_(0), pipelineDepth_(std::max<std::size_t>(pipelineDepth, 1)),
+      timeoutMs_(timeoutMs), unitId_(unitId), nextId_(0), inputLength_(0) {
+    Connect();
+}
+
+AsyncModbusClient::~AsyncModbusClient() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void AsyncModbusClient::Connect() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    std::string service = std::to_string(port_);
+    if (getaddrinfo(address_.c_str(), service.c_str(), &hints, &found) != 0) {
+        throw std::runtime_error("Failed to resolve Modbus server address");
+    }
+    for (addrinfo* ai = found; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc == 0 || errno == EINPROGRESS) {
+            // Requests queue until the handshake finishes; see OnWritable().
+            fd_ = fd;
+            connecting_ = rc != 0;
+            connectDeadlineMs_ = NowMs() + timeoutMs_;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(found);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to connect to Modbus server");
+    }
+    int nodelay = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+void AsyncModbusClient::Reconnect() {
+    if (fd_ < 0) {
+        Connect();
+    }
+}
+
+void AsyncModbusClient::Close() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    ++generation_;
+    connecting_ = false;
+    output_.clear();
+    inputLength_ = 0;
+    // Move everything out first: callbacks may submit again.
+    std::deque<Transaction> inFlight;
+    std::deque<Request> queued;
+    inFlight.swap(inFlight_);
+    queued.swap(queued_);
+    for (Transaction& t : inFlight) {
+        t.callback(TransactionStatus::Disconnected, nullptr, 0);
+    }
+    for (Request& r : queued) {
+        r.callback(TransactionStatus::Disconnected, nullptr, 0);
+    }
+}
+
+bool AsyncModbusClient::Connected() const {
+    return fd_ >= 0;
+}
+
+int AsyncModbusClient::Fd() const {
+    return fd_;
+}
+
+bool AsyncModbusClient::Connecting() const {
+    return connecting_;
+}
+
+bool AsyncModbusClient::WantsWrite() const {
+    return connecting_ || !output_.empty();
+}
+
+std::size_t AsyncModbusClient::InFlight() const {
+    return inFlight_.size();
+}
+
+std::size_t AsyncModbusClient::Queued() const {
+    return queued_.size();
+}
+
+int64_t AsyncModbusClient::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void AsyncModbusClient::Transact(const uint8_t* pdu, std::size_t length, PduCallback callback) {
+    if (length == 0 || length > kMaxPduLength) {
+        throw std::runtime_error("Invalid Modbus PDU length");
+    }
+    if (fd_ < 0) {
+        callback(TransactionStatus::Disconnected, nullptr, 0);
+        return;
+    }
+    if (!connecting_ && queued_.empty() && inFlight_.size() < pipelineDepth_) {
+        // Room in the pipeline: encode straight into the output buffer.
+        Encode(pdu, length, std::move(callback), NowMs() + timeoutMs_);
+        Flush();
+        return;
+    }
+    queued_.emplace_back();
+    Request& request = queued_.back();
+    request.length = length;
+    std::memcpy(request.pdu.data(), pdu, length);
+    request.callback = std::move(callback);
+    SendQueued();
+}
+
+void AsyncModbusClient::ReadHoldingRegisters(int start, int count, RegistersCallback callback) {
+    ReadRegisters(kReadHoldingRegisters, start, count, std::move(callback));
+}
+
+void AsyncModbusClient::ReadInputRegisters(int start, int count, RegistersCallback callback) {
+    ReadRegisters(kReadInputRegisters, start, count, std::move(callback));
+}
+
+void AsyncModbusClient::ReadRegisters(uint8_t functionCode, int start, int count, RegistersCallback callback) {
+    if (start < 0 || start > UINT16_MAX || count < 1 || count > kMaxReadRegisters) {
+        throw std::runtime_error("Invalid register range");
+    }
+    uint8_t pdu[5] = {functionCode};
+    ModbusCodec::WriteU16(pdu + 1, static_cast<uint16_t>(start));
+    ModbusCodec::WriteU16(pdu + 3, static_cast<uint16_t>(count));
+    Transact(pdu, sizeof(pdu),
+             [this, functionCode, count, callback = std::move(callback)](TransactionStatus status,
+                                                                        const uint8_t* reply, std::size_t length) {
+                 if (status != TransactionStatus::Ok) {
+                     callback(status, nullptr, 0);
+                     return;
+                 }
+                 std::size_t bytes = static_cast<std::size_t>(count) * 2;
+                 if (length != 2 + bytes || reply[0] != functionCode || reply[1] != bytes) {
+                     callback(TransactionStatus::Exception, nullptr, 0);
+                     return;
+                 }
+                 values_.resize(static_cast<std::size_t>(count));
+                 for (int i = 0; i < count; ++i) {
+                     values_[i] = ModbusCodec::ReadU16(reply + 2 + 2 * i);
+                 }
+                 callback(TransactionStatus::Ok, values_.data(), values_.size());
+             });
+}
+
+void AsyncModbusClient::ReadCoils(int start, int count, BitsCallback callback) {
+    ReadBits(kReadCoils, start, count, std::move(callback));
+}
+
+void AsyncModbusClient::ReadDiscreteInputs(int start, int count, BitsCallback callback) {
+    ReadBits(kReadDiscreteInputs, start, count, std::move(callback));
+}
+
+void AsyncModbusClient::ReadBits(uint8_t functionCode, int start, int count, BitsCallback callback) {
+    if (start < 0 || start > UINT16_MAX || count < 1 || count > kMaxReadBits) {
+        throw std::runtime_error("Invalid bit range");
+    }
+    uint8_t pdu[5] = {functionCode};
+    ModbusCodec::WriteU16(pdu + 1, static_cast<uint16_t>(start));
+    ModbusCodec::WriteU16(pdu + 3, static_cast<uint16_t>(count));
+    Transact(pdu, sizeof(pdu),
+             [this, functionCode, count, callback = std::move(callback)](TransactionStatus status,
+                                                                        const uint8_t* reply, std::size_t length) {
+                 if (status != TransactionStatus::Ok) {
+                     callback(status, nullptr, 0);
+                     return;
+                 }
+                 std::size_t bytes = (static_cast<std::size_t>(count) + 7) / 8;
+                 if (length != 2 + bytes || reply[0] != functionCode || reply[1] != bytes) {
+                     callback(TransactionStatus::Exception, nullptr, 0);
+                     return;
+                 }
+                 bits_.resize(static_cast<std::size_t>(count));
+                 for (int i = 0; i < count; ++i) {
+                     bits_[i] = (reply[2 + i / 8] >> (i % 8)) & 1;
+                 }
+                 callback(TransactionStatus::Ok, bits_.data(), bits_.size());
+             });
+}
+
+void AsyncModbusClient::WriteRegisters(int start, const uint16_t* values, int count, PduCallback callback) {
+    if (start < 0 || start > UINT16_MAX || count < 1 || count > kMaxWriteRegisters) {
+        throw std::runtime_error("Invalid register range");
+    }
+    uint8_t pdu[kMaxPduLength] = {kWriteMultipleRegisters};
+    ModbusCodec::WriteU16(pdu + 1, static_cast<uint16_t>(start));
+    ModbusCodec::WriteU16(pdu + 3, static_cast<uint16_t>(count));
+    pdu[5] = static_cast<uint8_t>(count * 2);
+    for (int i = 0; i < count; ++i) {
+        ModbusCodec::WriteU16(pdu + 6 + 2 * i, values[i]);
+    }
+    Transact(pdu, 6 + 2 * static_cast<std::size_t>(count), std::move(callback));
+}
+
+std::future<std::vector<uint16_t>> AsyncModbusClient::ReadHoldingRegisters(int start, int count) {
+    auto promise = std::make_shared<std::promise<std::vector<uint16_t>>>();
+    std::future<std::vector<uint16_t>> result = promise->get_future();
+    ReadHoldingRegisters(start, count, [promise](TransactionStatus status, const uint16_t* values, std::size_t n) {
+        if (status == TransactionStatus::Ok) {
+            promise->set_value(std::vector<uint16_t>(values, values + n));
+        } else {
+            promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to read registers")));
+        }
+    });
+    return result;
+}
+
+// Moves queued requests onto the wire while the pipeline has room.
+void AsyncModbusClient::SendQueued() {
+    if (fd_ < 0 || connecting_) {
+        return;
+    }
+    int64_t deadline = NowMs() + timeoutMs_;
+    while (!queued_.empty() && inFlight_.size() < pipelineDepth_) {
+        Request& request = queued_.front();
+        Encode(request.pdu.data(), request.length, std::move(request.callback), deadline);
+        queued_.pop_front();
+    }
+    Flush();
+}
+
+void AsyncModbusClient::Encode(const uint8_t* pdu, std::size_t length, PduCallback callback, int64_t deadlineMs) {
+    uint16_t id = nextId_++;
+    std::size_t offset = output_.size();
+    output_.resize(offset + ModbusCodec::kMbapHeaderLength + length);
+    uint8_t* frame = output_.data() + offset;
+    ModbusCodec::WriteHeader(frame, id, unitId_, length);
+    std::memcpy(frame + ModbusCodec::kMbapHeaderLength, pdu, length);
+    inFlight_.push_back(Transaction{id, deadlineMs, std::move(callback)});
+}
+
+void AsyncModbusClient::Flush() {
+    std::size_t sent = 0;
+    while (sent < output_.size()) {
+        ssize_t n = send(fd_, output_.data() + sent, output_.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            Close();
+            return;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    output_.erase(output_.begin(), output_.begin() + static_cast<std::ptrdiff_t>(sent));
+}
+
+void AsyncModbusClient::OnWritable() {
+    if (fd_ < 0) {
+        return;
+    }
+    if (connecting_) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            Close();
+            return;
+        }
+        connecting_ = false;
+        SendQueued();
+        return;
+    }
+    Flush();
+}
+
+void AsyncModbusClient::OnReadable() {
+    while (fd_ >= 0) {
+        ssize_t received = recv(fd_, input_.data() + inputLength_, input_.size() - inputLength_, MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+            Close();
+            return;
+        }
+        if (received < 0) {
+            break;
+        }
+        inputLength_ += static_cast<std::size_t>(received);
+
+        std::size_t offset = 0;
+        for (;;) {
+            ModbusCodec::Frame frame;
+            ModbusCodec::ParseResult parsed = ModbusCodec::Parse(input_.data() + offset, inputLength_ - offset, frame);
+            if (parsed == ModbusCodec::ParseResult::Invalid) {
+                Close();
+                return;
+            }
+            if (parsed == ModbusCodec::ParseResult::Incomplete) {
+                break;
+            }
+            // The callback may Close() or even Reconnect(), which empties
+            // the buffer; the rest of it belonged to the old connection.
+            uint32_t generation = generation_;
+            Complete(frame.transactionId, frame.pdu, frame.pduLength);
+            if (generation != generation_) {
+                return;
+            }
+            offset += frame.size;
+        }
+        std::memmove(input_.data(), input_.data() + offset, inputLength_ - offset);
+        inputLength_ -= offset;
+    }
+    SendQueued();
+}
+
+void AsyncModbusClient::Complete(uint16_t id, const uint8_t* pdu, std::size_t length) {
+    auto it = std::find_if(inFlight_.begin(), inFlight_.end(), [id](const Transaction& t) { return t.id == id; });
+    if (it == inFlight_.end()) {
+        return;   // a reply that arrived after its request timed out
+    }
+    PduCallback callback = std::move(it->callback);
+    inFlight_.erase(it);
+    TransactionStatus status = (pdu[0] & 0x80) ? TransactionStatus::Exception : TransactionStatus::Ok;
+    callback(status, pdu, length);
+}
+
+void AsyncModbusClient::CheckTimeouts(int64_t nowMs) {
+    if (connecting_ && connectDeadlineMs_ <= nowMs) {
+        Close();
+        return;
+    }
+    // Every request in flight was sent with the same timeout, so deadlines
+    // grow from front to back.
+    bool expired = false;
+    while (!inFlight_.empty() && inFlight_.front().deadlineMs <= nowMs) {
+        PduCallback callback = std::move(inFlight_.front().callback);
+        inFlight_.pop_front();
+        callback(TransactionStatus::Timeout, nullptr, 0);
+        expired = true;
+    }
+    if (expired) {
+        SendQueued();
+    }
+}
+
+bool AsyncModbusClient::Poll(int timeoutMs) {
+    if (fd_ >= 0 && (connecting_ || !inFlight_.empty())) {
+        int64_t deadline = connecting_ ? connectDeadlineMs_ : inFlight_.front().deadlineMs;
+        int64_t untilDeadline = deadline - NowMs();
+        pollfd pfd{fd_, static_cast<short>(POLLIN | (WantsWrite() ? POLLOUT : 0)), 0};
+        int wait = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(timeoutMs, untilDeadline)));
+        if (poll(&pfd, 1, wait) > 0) {
+            if (pfd.revents & POLLOUT) {
+                OnWritable();
+            }
+            if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+                OnReadable();
+            }
+        }
+    }
+    CheckTimeouts(NowMs());
+    return !inFlight_.empty() || !queued_.empty();
+}
+
+void AsyncModbusClient::Drain() {
+    while (Poll(timeoutMs_)) {
+    }
+}
@@ -0,0 +1,300 @@
+#include "Historian.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// Widest encoding of one sample: a 4-bit timestamp tag with a raw 64-bit
+// delta-of-delta, then a 2-bit value tag, a new 5+6-bit window and 64 bits.
+constexpr uint32_t kMaxSampleBits = 4 + 64 + 2 + 5 + 6 + 64;
+constexpr unsigned kNoWindow = 64;
+
+uint64_t ToBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double FromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+}
+
+Historian::Historian(std::size_t tags, int64_t retentionMs)
+    : series_(tags), retentionMs_(retentionMs), samples_(0), blocks_(0), readers_(0) {}
+
+Historian::~Historian() {
+    for (Series& series : series_) {
+        Block* block = series.head.load();
+        while (block) {
+            Block* next = block->next.load();
+            delete block;
+            block = next;
+        }
+        for (Block* retired : series.retired) {
+            delete retired;
+        }
+    }
+}
+
+bool Historian::Append(std::size_t tag, int64_t timestampMs, double value) {
+    if (tag >= series_.size()) {
+        throw std::runtime_error("Unknown historian tag");
+    }
+    Series& series = series_[tag];
+    if (series.tail && timestampMs < series.writer.timestampMs) {
+        return false;
+    }
+    if (!series.tail || series.writer.bit + kMaxSampleBits > kWords * 64) {
+        StartBlock(series, timestampMs);
+    }
+    Block& block = *series.tail;
+    uint32_t count = block.count.load(std::memory_order_relaxed);
+    if (count == 0) {
+        series.writer.timestampMs = timestampMs;
+        series.writer.valueBits = ToBits(value);
+        Put(block, series.writer.bit, series.writer.valueBits, 64);
+    } else {
+        Encode(block, series.writer, timestampMs, ToBits(value));
+    }
+    // Publishes the bits written above to readers.
+    block.count.store(count + 1, std::memory_order_release);
+    samples_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void Historian::AppendPoll(std::size_t firstTag, int64_t timestampMs, const uint16_t* values, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        Append(firstTag + i, timestampMs, values[i]);
+    }
+}
+
+void Historian::StartBlock(Series& series, int64_t timestampMs) {
+    Block* block = new Block();
+    block->firstTimestampMs = timestampMs;
+    series.writer = Cursor{};
+    series.writer.leading = kNoWindow;
+    series.writer.trailing = kNoWindow;
+    if (series.tail) {
+        series.tail->next.store(block, std::memory_order_release);
+    } else {
+        series.head.store(block);
+    }
+    series.tail = block;
+    blocks_.fetch_add(1, std::memory_order_relaxed);
+    Retire(series, timestampMs);
+}
+
+// Unlinks blocks that lie wholly before the retention window and frees
+// unlinked blocks once no query can still be reading them. A query counts
+// itself in readers_ before it loads the head, so a zero count seen after
+// the unlink means nobody holds an old pointer.
+void Historian::Retire(Series& series, int64_t nowMs) {
+    if (retentionMs_ > 0) {
+        Block* head = series.head.load();
+        Block* next = head->next.load(std::memory_order_acquire);
+        while (next && next->firstTimestampMs <= nowMs - retentionMs_) {
+            series.head.store(next);
+            series.retired.push_back(head);
+            head = next;
+            next = head->next.load(std::memory_order_acquire);
+        }
+    }
+    if (!series.retired.empty() && readers_.load() == 0) {
+        for (Block* block : series.retired) {
+            delete block;
+        }
+        blocks_.fetch_sub(series.retired.size(), std::memory_order_relaxed);
+        series.retired.clear();
+    }
+}
+
+void Historian::Put(Block& block, uint32_t& bit, uint64_t value, unsigned width) {
+    while (width > 0) {
+        unsigned offset = bit % 64;
+        unsigned take = std::min(64 - offset, width);
+        uint64_t chunk = (value >> (width - take)) & (take == 64 ? ~uint64_t{0} : (uint64_t{1} << take) - 1);
+        std::atomic<uint64_t>& word = block.words[bit / 64];
+        // Only the writer stores; readers never look past the published count.
+        word.store(word.load(std::memory_order_relaxed) | (chunk << (64 - offset - take)),
+                   std::memory_order_relaxed);
+        bit += take;
+        width -= take;
+    }
+}
+
+uint64_t Historian::Get(const Block& block, uint32_t& bit, unsigned width) {
+    uint64_t value = 0;
+    while (width > 0) {
+        unsigned offset = bit % 64;
+        unsigned take = std::min(64 - offset, width);
+        uint64_t word = block.words[bit / 64].load(std::memory_order_relaxed);
+        uint64_t chunk = (word >> (64 - offset - take)) & (take == 64 ? ~uint64_t{0} : (uint64_t{1} << take) - 1);
+        value = take == 64 ? chunk : (value << take) | chunk;
+        bit += take;
+        width -= take;
+    }
+    return value;
+}
+
+void Historian::Encode(Block& block, Cursor& cursor, int64_t timestampMs, uint64_t valueBits) {
+    int64_t delta = timestampMs - cursor.timestampMs;
+    int64_t dod = delta - cursor.deltaMs;
+    if (dod == 0) {
+        Put(block, cursor.bit, 0b0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        Put(block, cursor.bit, 0b10, 2);
+        Put(block, cursor.bit, static_cast<uint64_t>(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        Put(block, cursor.bit, 0b110, 3);
+        Put(block, cursor.bit, static_cast<uint64_t>(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        Put(block, cursor.bit, 0b1110, 4);
+        Put(block, cursor.bit, static_cast<uint64_t>(dod + 2047), 12);
+    } else {
+        Put(block, cursor.bit, 0b1111, 4);
+        Put(block, cursor.bit, static_cast<uint64_t>(dod), 64);
+    }
+    cursor.timestampMs = timestampMs;
+    cursor.deltaMs = delta;
+
+    uint64_t x = valueBits ^ cursor.valueBits;
+    cursor.valueBits = valueBits;
+    if (x == 0) {
+        Put(block, cursor.bit, 0b0, 1);
+        return;
+    }
+    unsigned leading = std::min(static_cast<unsigned>(__builtin_clzll(x)), 31u);
+    unsigned trailing = static_cast<unsigned>(__builtin_ctzll(x));
+    if (leading >= cursor.leading && trailing >= cursor.trailing) {
+        // The changed bits fit the previous window.
+        Put(block, cursor.bit, 0b10, 2);
+        Put(block, cursor.bit, x >> cursor.trailing, 64 - cursor.leading - cursor.trailing);
+        return;
+    }
+    unsigned meaningful = 64 - leading - trailing;
+    Put(block, cursor.bit, 0b11, 2);
+    Put(block, cursor.bit, leading, 5);
+    Put(block, cursor.bit, meaningful - 1, 6);
+    Put(block, cursor.bit, x >> trailing, meaningful);
+    cursor.leading = leading;
+    cursor.trailing = trailing;
+}
+
+void Historian::Decode(const Block& block, Cursor& cursor, bool first) {
+    if (first) {
+        cursor = Cursor{};
+        cursor.timestampMs = block.firstTimestampMs;
+        cursor.valueBits = Get(block, cursor.bit, 64);
+        cursor.leading = kNoWindow;
+        cursor.trailing = kNoWindow;
+        return;
+    }
+    int64_t dod;
+    if (Get(block, cursor.bit, 1) == 0) {
+        dod = 0;
+    } else if (Get(block, cursor.bit, 1) == 0) {
+        dod = static_cast<int64_t>(Get(block, cursor.bit, 7)) - 63;
+    } else if (Get(block, cursor.bit, 1) == 0) {
+        dod = static_cast<int64_t>(Get(block, cursor.bit, 9)) - 255;
+    } else if (Get(block, cursor.bit, 1) == 0) {
+        dod = static_cast<int64_t>(Get(block, cursor.bit, 12)) - 2047;
+    } else {
+        dod = static_cast<int64_t>(Get(block, cursor.bit, 64));
+    }
+    cursor.deltaMs += dod;
+    cursor.timestampMs += cursor.deltaMs;
+
+    if (Get(block, cursor.bit, 1) == 0) {
+        return;
+    }
+    if (Get(block, cursor.bit, 1) == 0) {
+        uint64_t x = Get(block, cursor.bit, 64 - cursor.leading - cursor.trailing);
+        cursor.valueBits ^= x << cursor.trailing;
+        return;
+    }
+    cursor.leading = static_cast<unsigned>(Get(block, cursor.bit, 5));
+    unsigned meaningful = static_cast<unsigned>(Get(block, cursor.bit, 6)) + 1;
+    cursor.trailing = 64 - cursor.leading - meaningful;
+    cursor.valueBits ^= Get(block, cursor.bit, meaningful) << cursor.trailing;
+}
+
+template <typename Visit>
+void Historian::Scan(std::size_t tag, int64_t fromMs, int64_t toMs, Visit visit) const {
+    if (tag >= series_.size()) {
+        throw std::runtime_error("Unknown historian tag");
+    }
+    readers_.fetch_add(1);
+    for (const Block* block = series_[tag].head.load(); block;) {
+        const Block* next = block->next.load(std::memory_order_acquire);
+        if (block->firstTimestampMs >= toMs) {
+            break;
+        }
+        if (!next || next->firstTimestampMs >= fromMs) {
+            uint32_t count = block->count.load(std::memory_order_acquire);
+            Cursor cursor;
+            for (uint32_t i = 0; i < count; ++i) {
+                Decode(*block, cursor, i == 0);
+                if (cursor.timestampMs >= toMs) {
+                    break;
+                }
+                if (cursor.timestampMs >= fromMs) {
+                    visit(cursor.timestampMs, FromBits(cursor.valueBits));
+                }
+            }
+        }
+        block = next;
+    }
+    readers_.fetch_sub(1);
+}
+
+std::vector<HistorySample> Historian::Range(std::size_t tag, int64_t fromMs, int64_t toMs) const {
+    std::vector<HistorySample> samples;
+    Scan(tag, fromMs, toMs, [&samples](int64_t timestampMs, double value) {
+        samples.push_back(HistorySample{timestampMs, value});
+    });
+    return samples;
+}
+
+std::vector<HistoryBucket> Historian::Downsample(std::size_t tag, int64_t fromMs, int64_t toMs,
+                                                 int64_t stepMs) const {
+    if (stepMs <= 0) {
+        throw std::runtime_error("Downsample step must be positive");
+    }
+    std::vector<HistoryBucket> buckets;
+    double sum = 0;
+    Scan(tag, fromMs, toMs, [&](int64_t timestampMs, double value) {
+        int64_t startMs = fromMs + (timestampMs - fromMs) / stepMs * stepMs;
+        if (buckets.empty() || buckets.back().startMs != startMs) {
+            if (!buckets.empty()) {
+                buckets.back().mean = sum / buckets.back().count;
+            }
+            buckets.push_back(HistoryBucket{startMs, 0, value, value, 0, value});
+            sum = 0;
+        }
+        HistoryBucket& bucket = buckets.back();
+        ++bucket.count;
+        bucket.min = std::min(bucket.min, value);
+        bucket.max = std::max(bucket.max, value);
+        bucket.last = value;
+        sum += value;
+    });
+    if (!buckets.empty()) {
+        buckets.back().mean = sum / buckets.back().count;
+    }
+    return buckets;
+}
+
+std::size_t Historian::TagCount() const {
+    return series_.size();
+}
+
+uint64_t Historian::SampleCount() const {
+    return samples_.load(std::memory_order_relaxed);
+}
+
+std::size_t Historian::MemoryBytes() const {
+    return blocks_.load(std::memory_order_relaxed) * sizeof(Block) + series_.size() * sizeof(Series);
+}
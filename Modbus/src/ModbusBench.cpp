@@ -0,0 +1,217 @@
+#include "ModbusBench.hpp"
+#include "AsyncModbusClient.hpp"
+#include "ModbusServer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint32_t Percentile(const std::vector<uint32_t>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+// Builds the request PDU a case sends over and over.
+std::vector<uint8_t> RequestPdu(int functionCode, int count) {
+    std::vector<uint8_t> pdu(5);
+    pdu[0] = static_cast<uint8_t>(functionCode);
+    ModbusCodec::WriteU16(pdu.data() + 1, 0);
+    // Single writes carry a value where the others carry a count.
+    ModbusCodec::WriteU16(pdu.data() + 3, static_cast<uint16_t>(functionCode == 0x05 ? 0xFF00 : count));
+    if (functionCode == 0x0F || functionCode == 0x10) {
+        std::size_t bytes = functionCode == 0x10 ? 2 * static_cast<std::size_t>(count)
+                                                 : (static_cast<std::size_t>(count) + 7) / 8;
+        pdu.push_back(static_cast<uint8_t>(bytes));
+        pdu.resize(pdu.size() + bytes, 0x5A);
+    }
+    return pdu;
+}
+
+int MaxCount(int functionCode) {
+    switch (functionCode) {
+        case 0x01:
+        case 0x02:
+            return 2000;
+        case 0x05:
+        case 0x06:
+            return 1;
+        case 0x0F:
+            return 1968;
+        case 0x10:
+            return 123;
+        default:
+            return AsyncModbusClient::kMaxReadRegisters;
+    }
+}
+
+// One client thread: owns some connections and keeps each pipeline full
+// until the deadline, then waits for what is still in flight.
+struct Driver {
+    std::vector<std::unique_ptr<AsyncModbusClient>> clients;
+    std::vector<uint32_t> latencies;
+    uint64_t errors = 0;
+
+    void Run(const std::vector<uint8_t>& pdu, std::size_t depth, int64_t endUs) {
+        std::vector<pollfd> fds(clients.size());
+        bool sending = true;
+        for (;;) {
+            sending = sending && NowUs() < endUs;
+            bool busy = false;
+            for (std::size_t i = 0; i < clients.size(); ++i) {
+                AsyncModbusClient& client = *clients[i];
+                while (sending && client.Connected() && client.InFlight() + client.Queued() < depth) {
+                    int64_t started = NowUs();
+                    client.Transact(pdu.data(), pdu.size(),
+                                    [this, started](TransactionStatus status, const uint8_t* reply, std::size_t) {
+                                        if (status != TransactionStatus::Ok || (reply[0] & 0x80)) {
+                                            ++errors;
+                                            return;
+                                        }
+                                        latencies.push_back(static_cast<uint32_t>(NowUs() - started));
+                                    });
+                }
+                busy = busy || client.InFlight() > 0 || client.Queued() > 0;
+                fds[i] = pollfd{client.Fd(), static_cast<short>(POLLIN | (client.WantsWrite() ? POLLOUT : 0)), 0};
+            }
+            if (!busy && !sending) {
+                return;
+            }
+            if (poll(fds.data(), fds.size(), 10) > 0) {
+                for (std::size_t i = 0; i < clients.size(); ++i) {
+                    if (fds[i].revents & POLLOUT) {
+                        clients[i]->OnWritable();
+                    }
+                    if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                        clients[i]->OnReadable();
+                    }
+                }
+            }
+            int64_t nowMs = AsyncModbusClient::NowMs();
+            for (auto& client : clients) {
+                client->CheckTimeouts(nowMs);
+            }
+        }
+    }
+};
+}
+
+std::string BenchResult::ToJson() const {
+    std::ostringstream out;
+    out << "{\"codec\":\"" << (nativeCodec ? "native" : "libmodbus") << "\""
+        << ",\"function_code\":" << functionCode
+        << ",\"count\":" << count
+        << ",\"depth\":" << depth
+        << ",\"connections\":" << connections
+        << ",\"requests\":" << requests
+        << ",\"errors\":" << errors
+        << ",\"seconds\":" << seconds
+        << ",\"requests_per_sec\":" << static_cast<uint64_t>(requestsPerSecond)
+        << ",\"latency_us\":{\"p50\":" << p50Us
+        << ",\"p90\":" << p90Us
+        << ",\"p99\":" << p99Us
+        << ",\"p999\":" << p999Us
+        << ",\"max\":" << maxUs << "}}";
+    return out.str();
+}
+
+ModbusBench::ModbusBench(BenchOptions options) : options_(std::move(options)) {}
+
+std::vector<BenchResult> ModbusBench::Run() {
+    std::vector<BenchResult> results;
+    for (bool native : options_.nativeCodec) {
+        for (int functionCode : options_.functionCodes) {
+            std::vector<int> counts;   // clamped to what the function code allows, without repeats
+            for (int count : options_.counts) {
+                int clamped = std::min(count, MaxCount(functionCode));
+                if (std::find(counts.begin(), counts.end(), clamped) == counts.end()) {
+                    counts.push_back(clamped);
+                }
+            }
+            for (int count : counts) {
+                for (int connections : options_.connections) {
+                    for (int depth : options_.depths) {
+                        results.push_back(RunCase(native, functionCode, count, depth, connections));
+                    }
+                }
+            }
+        }
+    }
+    return results;
+}
+
+BenchResult ModbusBench::RunCase(bool nativeCodec, int functionCode, int count, int depth, int connections) {
+    // A fresh server per case, so every case starts without old connections.
+    ModbusServer server("127.0.0.1", options_.port);
+    server.UseNativeCodec(nativeCodec);
+    std::thread serverThread([&server]() { server.Run(); });
+
+    std::size_t threadCount = static_cast<std::size_t>(std::max(1, std::min(options_.clientThreads, connections)));
+    std::vector<Driver> drivers(threadCount);
+    try {
+        for (int c = 0; c < connections; ++c) {
+            drivers[static_cast<std::size_t>(c) % threadCount].clients.push_back(
+                std::make_unique<AsyncModbusClient>("127.0.0.1", options_.port, static_cast<std::size_t>(depth)));
+        }
+    } catch (...) {
+        server.Stop();
+        serverThread.join();
+        throw;
+    }
+
+    std::vector<uint8_t> pdu = RequestPdu(functionCode, count);
+    int64_t startUs = NowUs();
+    int64_t endUs = startUs + static_cast<int64_t>(options_.durationMs) * 1000;
+    std::vector<std::thread> threads;
+    for (Driver& driver : drivers) {
+        threads.emplace_back([&driver, &pdu, depth, endUs]() {
+            driver.Run(pdu, static_cast<std::size_t>(depth), endUs);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = static_cast<double>(NowUs() - startUs) / 1e6;
+    for (Driver& driver : drivers) {
+        driver.clients.clear();
+    }
+    server.Stop();
+    serverThread.join();
+
+    std::vector<uint32_t> latencies;
+    uint64_t errors = 0;
+    for (Driver& driver : drivers) {
+        latencies.insert(latencies.end(), driver.latencies.begin(), driver.latencies.end());
+        errors += driver.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    BenchResult result{};
+    result.nativeCodec = nativeCodec;
+    result.functionCode = functionCode;
+    result.count = count;
+    result.depth = depth;
+    result.connections = connections;
+    result.requests = latencies.size();
+    result.errors = errors;
+    result.seconds = seconds;
+    result.requestsPerSecond = static_cast<double>(latencies.size()) / seconds;
+    result.p50Us = Percentile(latencies, 0.50);
+    result.p90Us = Percentile(latencies, 0.90);
+    result.p99Us = Percentile(latencies, 0.99);
+    result.p999Us = Percentile(latencies, 0.999);
+    result.maxUs = latencies.empty() ? 0 : latencies.back();
+    return result;
+}
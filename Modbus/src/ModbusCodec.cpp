@@ -0,0 +1,161 @@
+#include "ModbusCodec.hpp"
+#include <array>
+
+namespace {
+constexpr uint8_t kIllegalDataAddress = 0x02;
+constexpr uint8_t kIllegalDataValue = 0x03;
+
+struct FunctionSpec {
+    bool native;
+    RegisterTable table;
+    uint8_t requestLength;     // 0: 6 + byte count at pdu[5]
+    uint16_t maxQuantity;      // 0: single write, no quantity field
+};
+
+// Indexed by function code; built at compile time so validation is one
+// table lookup per request.
+constexpr std::array<FunctionSpec, 256> kFunctionSpecs = [] {
+    std::array<FunctionSpec, 256> specs{};
+    specs[0x01] = {true, RegisterTable::Coils, 5, 2000};
+    specs[0x02] = {true, RegisterTable::DiscreteInputs, 5, 2000};
+    specs[0x03] = {true, RegisterTable::HoldingRegisters, 5, 125};
+    specs[0x04] = {true, RegisterTable::InputRegisters, 5, 125};
+    specs[0x05] = {true, RegisterTable::Coils, 5, 0};
+    specs[0x06] = {true, RegisterTable::HoldingRegisters, 5, 0};
+    specs[0x0F] = {true, RegisterTable::Coils, 0, 1968};
+    specs[0x10] = {true, RegisterTable::HoldingRegisters, 0, 123};
+    return specs;
+}();
+
+std::size_t Exception(uint8_t* out, uint8_t functionCode, uint8_t code) {
+    out[0] = static_cast<uint8_t>(functionCode | 0x80);
+    out[1] = code;
+    return 2;
+}
+}
+
+ModbusCodec::ParseResult ModbusCodec::Parse(const uint8_t* data, std::size_t length, Frame& frame) {
+    if (length < kMbapHeaderLength) {
+        return ParseResult::Incomplete;
+    }
+    uint16_t fieldLength = ReadU16(data + 4);   // unit identifier + PDU
+    if (ReadU16(data + 2) != 0 || fieldLength < 2 || fieldLength > kMaxPduLength + 1) {
+        return ParseResult::Invalid;
+    }
+    std::size_t size = 6 + static_cast<std::size_t>(fieldLength);
+    if (length < size) {
+        return ParseResult::Incomplete;
+    }
+    frame.transactionId = ReadU16(data);
+    frame.unitId = data[6];
+    frame.pdu = data + kMbapHeaderLength;
+    frame.pduLength = fieldLength - 1;
+    frame.size = size;
+    return ParseResult::Complete;
+}
+
+void ModbusCodec::WriteHeader(uint8_t* out, uint16_t transactionId, uint8_t unitId, std::size_t pduLength) {
+    WriteU16(out, transactionId);
+    WriteU16(out + 2, 0);
+    WriteU16(out + 4, static_cast<uint16_t>(pduLength + 1));
+    out[6] = unitId;
+}
+
+bool ModbusCodec::Handles(uint8_t functionCode) {
+    return kFunctionSpecs[functionCode].native;
+}
+
+std::size_t ModbusCodec::Serve(RegisterMap& registers, const uint8_t* pdu, std::size_t length, uint8_t* out) {
+    uint8_t functionCode = pdu[0];
+    const FunctionSpec& spec = kFunctionSpecs[functionCode];
+    bool lengthOk = spec.requestLength != 0 ? length == spec.requestLength : length >= 6 && length == 6u + pdu[5];
+    if (!lengthOk) {
+        return Exception(out, functionCode, kIllegalDataValue);
+    }
+    uint16_t address = ReadU16(pdu + 1);
+    uint16_t quantity = ReadU16(pdu + 3);   // the value, for single writes
+    if (spec.maxQuantity != 0) {
+        if (quantity == 0 || quantity > spec.maxQuantity) {
+            return Exception(out, functionCode, kIllegalDataValue);
+        }
+        if (address + static_cast<std::size_t>(quantity) > RegisterMap::kTableSize) {
+            return Exception(out, functionCode, kIllegalDataAddress);
+        }
+    }
+
+    switch (functionCode) {
+        case 0x01:
+        case 0x02: {
+            uint8_t bits[2000];
+            registers.ReadBits(spec.table, address, bits, quantity);
+            std::size_t bytes = (quantity + 7u) / 8;
+            out[0] = functionCode;
+            out[1] = static_cast<uint8_t>(bytes);
+            for (std::size_t b = 0; b < bytes; ++b) {
+                uint8_t packed = 0;
+                for (std::size_t i = b * 8; i < b * 8 + 8 && i < quantity; ++i) {
+                    packed = static_cast<uint8_t>(packed | (bits[i] << (i % 8)));
+                }
+                out[2 + b] = packed;
+            }
+            return 2 + bytes;
+        }
+        case 0x03:
+        case 0x04: {
+            uint16_t values[125];
+            registers.ReadRegisters(spec.table, address, values, quantity);
+            out[0] = functionCode;
+            out[1] = static_cast<uint8_t>(quantity * 2);
+            for (std::size_t i = 0; i < quantity; ++i) {
+                WriteU16(out + 2 + 2 * i, values[i]);
+            }
+            return 2 + 2 * static_cast<std::size_t>(quantity);
+        }
+        case 0x05: {
+            if (quantity != 0xFF00 && quantity != 0x0000) {
+                return Exception(out, functionCode, kIllegalDataValue);
+            }
+            uint8_t bit = quantity != 0;
+            registers.WriteBits(spec.table, address, &bit, 1);
+            for (std::size_t i = 0; i < 5; ++i) {
+                out[i] = pdu[i];
+            }
+            return 5;
+        }
+        case 0x06:
+            registers.WriteRegisters(spec.table, address, &quantity, 1);
+            for (std::size_t i = 0; i < 5; ++i) {
+                out[i] = pdu[i];
+            }
+            return 5;
+        case 0x0F: {
+            if (pdu[5] * 8u < quantity) {   // as lenient as libmodbus about extra bytes
+                return Exception(out, functionCode, kIllegalDataValue);
+            }
+            uint8_t bits[1968];
+            for (std::size_t i = 0; i < quantity; ++i) {
+                bits[i] = (pdu[6 + i / 8] >> (i % 8)) & 1;
+            }
+            registers.WriteBits(spec.table, address, bits, quantity);
+            break;
+        }
+        case 0x10: {
+            if (pdu[5] != quantity * 2u) {
+                return Exception(out, functionCode, kIllegalDataValue);
+            }
+            uint16_t values[123];
+            for (std::size_t i = 0; i < quantity; ++i) {
+                values[i] = ReadU16(pdu + 6 + 2 * i);
+            }
+            registers.WriteRegisters(spec.table, address, values, quantity);
+            break;
+        }
+        default:
+            return Exception(out, functionCode, 0x01);   // illegal function; Handles() was false
+    }
+    // Multiple writes echo the address and quantity.
+    for (std::size_t i = 0; i < 5; ++i) {
+        out[i] = pdu[i];
+    }
+    return 5;
+}
@@ -0,0 +1,620 @@
+#include "ModbusGateway.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+constexpr int kListenBacklog = SOMAXCONN;
+constexpr int kMaxEvents = 256;
+constexpr int64_t kTickMs = 10;
+constexpr int64_t kMinBackoffMs = 500;
+constexpr int64_t kMaxBackoffMs = 30000;
+// Stop reading from a client with this many requests unanswered.
+constexpr std::size_t kMaxPendingReplies = 64;
+
+constexpr uint64_t kWakeToken = UINT64_MAX;
+constexpr uint64_t kListenToken = UINT64_MAX - 1;
+constexpr uint64_t kBackendToken = uint64_t{1} << 32;   // | backend index; front-end fds are below
+
+constexpr uint8_t kAnyUnit = 0xFF;
+constexpr uint8_t kDeviceFailure = 0x04;
+constexpr uint8_t kPathUnavailable = 0x0A;
+constexpr uint8_t kTargetNoResponse = 0x0B;
+
+bool IsBitRead(uint8_t functionCode) {
+    return functionCode == 0x01 || functionCode == 0x02;
+}
+
+int MaxReadCount(uint8_t functionCode) {
+    return IsBitRead(functionCode) ? AsyncModbusClient::kMaxReadBits : AsyncModbusClient::kMaxReadRegisters;
+}
+
+// A read the merge window can hold; anything else is forwarded as it comes.
+bool IsMergeableRead(const uint8_t* pdu, std::size_t length) {
+    if (pdu[0] < 0x01 || pdu[0] > 0x04 || length != 5) {
+        return false;
+    }
+    int start = ModbusCodec::ReadU16(pdu + 1);
+    int count = ModbusCodec::ReadU16(pdu + 3);
+    return count >= 1 && count <= MaxReadCount(pdu[0]) && start + count <= 0x10000;
+}
+
+uint8_t ExceptionFor(TransactionStatus status) {
+    return status == TransactionStatus::Timeout ? kTargetNoResponse : kPathUnavailable;
+}
+}
+
+ModbusGateway::ModbusGateway(const char* address, int port, GatewayOptions options)
+    : options_(std::move(options)), ctx_(nullptr), serverSocket_(-1), port_(port), epollFd_(-1), wakeFd_(-1),
+      running_(true), openCount_(0), windowEndsMs_(-1), requests_(0), deviceRequests_(0), mergedReads_(0) {
+
+    ctx_ = modbus_new_tcp(address, port);
+    if (!ctx_) {
+        throw std::runtime_error("Failed to create Modbus TCP context");
+    }
+    serverSocket_ = modbus_tcp_listen(ctx_, kListenBacklog);
+    if (serverSocket_ == -1) {
+        modbus_free(ctx_);
+        throw std::runtime_error("Failed to listen on socket");
+    }
+    fcntl(serverSocket_, F_SETFL, fcntl(serverSocket_, F_GETFL) | O_NONBLOCK);
+
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0) {
+        if (epollFd_ >= 0) close(epollFd_);
+        if (wakeFd_ >= 0) close(wakeFd_);
+        close(serverSocket_);
+        modbus_free(ctx_);
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kListenToken;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSocket_, &ev);
+    ev.data.u64 = kWakeToken;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+
+    backends_.resize(std::max<std::size_t>(options_.connections, 1));
+}
+
+ModbusGateway::~ModbusGateway() {
+    for (std::size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd] && connections_[fd]->open) {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (wakeFd_ >= 0) close(wakeFd_);
+    if (epollFd_ >= 0) close(epollFd_);
+    if (serverSocket_ >= 0) close(serverSocket_);
+    if (ctx_) modbus_free(ctx_);
+}
+
+void ModbusGateway::Run() {
+    std::cout << "Modbus TCP gateway on port " << port_ << " for " << options_.deviceAddress << ":"
+              << options_.devicePort << "..." << std::endl;
+
+    int64_t now = AsyncModbusClient::NowMs();
+    int64_t maintainAtMs = now;
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int64_t wakeAtMs = windowEndsMs_ >= 0 && DeviceReady() ? std::min(windowEndsMs_, maintainAtMs) : maintainAtMs;
+        int wait = static_cast<int>(std::max<int64_t>(wakeAtMs - AsyncModbusClient::NowMs(), 0));
+        int ready = epoll_wait(epollFd_, events, kMaxEvents, wait);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            uint64_t token = events[i].data.u64;
+            if (token == kListenToken) {
+                AcceptAll();
+            } else if (token == kWakeToken) {
+                uint64_t value;
+                ssize_t got = read(wakeFd_, &value, sizeof(value));
+                (void)got;
+            } else if (token >= kBackendToken) {
+                std::size_t b = static_cast<std::size_t>(token - kBackendToken);
+                AsyncModbusClient& client = *backends_[b].client;
+                if (events[i].events & EPOLLOUT) {
+                    client.OnWritable();
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    client.OnReadable();
+                }
+            } else {
+                int fd = static_cast<int>(token);
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    CloseConnection(fd);
+                } else if (events[i].events & EPOLLOUT) {
+                    OnWritable(fd);
+                } else {
+                    OnReadable(fd);
+                }
+            }
+        }
+        now = AsyncModbusClient::NowMs();
+        if (windowEndsMs_ >= 0 && now >= windowEndsMs_ && DeviceReady()) {
+            FlushReads();
+        }
+        if (now >= maintainAtMs) {
+            Maintain(now);
+            maintainAtMs = now + kTickMs;
+        }
+        SendReplies();
+        for (std::size_t b = 0; b < backends_.size(); ++b) {
+            Watch(b);
+        }
+    }
+}
+
+void ModbusGateway::Stop() {
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd_, &one, sizeof(one));
+    (void)written;
+}
+
+std::size_t ModbusGateway::ConnectionCount() const {
+    return openCount_;
+}
+
+GatewayStats ModbusGateway::Stats() const {
+    return GatewayStats{requests_.load(), deviceRequests_.load(), mergedReads_.load()};
+}
+
+void ModbusGateway::AcceptAll() {
+    for (;;) {
+        int fd = accept4(serverSocket_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        if (static_cast<std::size_t>(fd) >= connections_.size()) {
+            connections_.resize(fd + 1);
+        }
+        if (!connections_[fd]) {
+            connections_[fd] = std::make_unique<Connection>();
+        }
+        Connection& conn = *connections_[fd];
+        conn.open = true;
+        conn.length = 0;
+        conn.events = EPOLLIN | EPOLLRDHUP;
+        ++openCount_;
+
+        epoll_event ev{};
+        ev.events = conn.events;
+        ev.data.u64 = static_cast<uint64_t>(fd);
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void ModbusGateway::OnReadable(int fd) {
+    Connection& conn = *connections_[fd];
+    ssize_t received = recv(fd, conn.input + conn.length, sizeof(conn.input) - conn.length, MSG_DONTWAIT);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+        CloseConnection(fd);
+        return;
+    }
+    if (received < 0) {
+        return;
+    }
+    conn.length += static_cast<std::size_t>(received);
+    if (!ServeFrames(fd, conn)) {
+        CloseConnection(fd);
+        return;
+    }
+    UpdateEvents(fd, conn);
+}
+
+void ModbusGateway::OnWritable(int fd) {
+    Connection& conn = *connections_[fd];
+    if (!Flush(fd, conn) || !ServeFrames(fd, conn)) {
+        CloseConnection(fd);
+        return;
+    }
+    UpdateEvents(fd, conn);
+}
+
+// Takes every complete ADU from the buffer and gives each a reply slot, so
+// replies leave in request order however the device answers. Stops early
+// while the client has too much outstanding. Returns false if the stream is
+// not valid Modbus TCP.
+bool ModbusGateway::ServeFrames(int fd, Connection& conn) {
+    std::size_t offset = 0;
+    int64_t now = AsyncModbusClient::NowMs();
+    while (conn.replies.size() < kMaxPendingReplies && conn.output.empty()) {
+        ModbusCodec::Frame frame;
+        ModbusCodec::ParseResult parsed = ModbusCodec::Parse(conn.input + offset, conn.length - offset, frame);
+        if (parsed == ModbusCodec::ParseResult::Invalid) {
+            return false;
+        }
+        if (parsed == ModbusCodec::ParseResult::Incomplete) {
+            break;
+        }
+        if (MustWait(conn, frame)) {
+            if (!conn.blocked) {
+                // The client's reads may still be in the merge window.
+                conn.blocked = true;
+                FlushReads();
+            }
+            break;
+        }
+        conn.blocked = false;
+        conn.replies.emplace_back();
+        conn.replies.back().transactionId = frame.transactionId;
+        conn.replies.back().unitId = frame.unitId;
+        Waiter waiter{fd, conn.generation, conn.firstSequence + conn.replies.size() - 1};
+        ++requests_;
+        offset += frame.size;
+        if (frame.unitId != options_.unitId && frame.unitId != kAnyUnit) {
+            Fail(waiter, frame.pdu[0], kPathUnavailable);
+            continue;
+        }
+        if (backends_.size() > 1 && !IsMergeableRead(frame.pdu, frame.pduLength)) {
+            // Set first: a request that fails at once completes inside Dispatch().
+            conn.writePending = true;
+            conn.writeSequence = waiter.sequence;
+        }
+        Dispatch(frame.pdu, frame.pduLength, waiter, now);
+    }
+    if (offset > 0) {
+        std::memmove(conn.input, conn.input + offset, conn.length - offset);
+        conn.length -= offset;
+    }
+    return true;
+}
+
+// Requests on different device connections can reach the device in any
+// order. So with more than one, a client's write waits until everything it
+// sent before has been answered, and its later requests wait for the write.
+bool ModbusGateway::MustWait(const Connection& conn, const ModbusCodec::Frame& frame) const {
+    if (backends_.size() <= 1) {
+        return false;
+    }
+    if (conn.writePending) {
+        return true;
+    }
+    return !IsMergeableRead(frame.pdu, frame.pduLength) &&
+           std::any_of(conn.replies.begin(), conn.replies.end(), [](const Reply& reply) { return !reply.done; });
+}
+
+bool ModbusGateway::Flush(int fd, Connection& conn) {
+    std::size_t sent = 0;
+    while (sent < conn.output.size()) {
+        ssize_t n = send(fd, conn.output.data() + sent, conn.output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    conn.output.erase(conn.output.begin(), conn.output.begin() + static_cast<std::ptrdiff_t>(sent));
+    return true;
+}
+
+// Reads only while the client has room for more requests, its replies are
+// leaving and its next request is not waiting, and waits for EPOLLOUT while
+// the socket is full.
+void ModbusGateway::UpdateEvents(int fd, Connection& conn) {
+    bool reading = conn.replies.size() < kMaxPendingReplies && conn.output.empty() && !conn.blocked;
+    uint32_t events = EPOLLRDHUP | (reading ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                      (conn.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (events != conn.events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = static_cast<uint64_t>(fd);
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        conn.events = events;
+    }
+}
+
+// Moves the finished replies at the front of each touched connection into
+// one send. Requests held back while the client was at its limit are
+// picked up again here; completions they trigger at once land on dirty_
+// and are handled in the same pass.
+void ModbusGateway::SendReplies() {
+    for (std::size_t i = 0; i < dirty_.size(); ++i) {
+        int fd = dirty_[i];
+        Connection& conn = *connections_[fd];
+        conn.dirty = false;
+        if (!conn.open) {
+            continue;
+        }
+        while (!conn.replies.empty() && conn.replies.front().done) {
+            const Reply& reply = conn.replies.front();
+            std::size_t at = conn.output.size();
+            conn.output.resize(at + ModbusCodec::kMbapHeaderLength + reply.length);
+            ModbusCodec::WriteHeader(conn.output.data() + at, reply.transactionId, reply.unitId, reply.length);
+            std::memcpy(conn.output.data() + at + ModbusCodec::kMbapHeaderLength, reply.pdu.data(), reply.length);
+            conn.replies.pop_front();
+            ++conn.firstSequence;
+        }
+        if (!Flush(fd, conn) || !ServeFrames(fd, conn)) {
+            CloseConnection(fd);
+            continue;
+        }
+        UpdateEvents(fd, conn);
+    }
+    dirty_.clear();
+}
+
+void ModbusGateway::CloseConnection(int fd) {
+    Connection& conn = *connections_[fd];
+    if (!conn.open) {
+        return;
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conn.open = false;
+    ++conn.generation;
+    conn.blocked = false;
+    conn.writePending = false;
+    conn.length = 0;
+    conn.replies.clear();
+    conn.output.clear();
+    --openCount_;
+}
+
+// Holds well-formed reads for the merge window and forwards everything
+// else. A read the device would reject anyway goes straight through, so the
+// requester gets the device's own exception.
+void ModbusGateway::Dispatch(const uint8_t* pdu, std::size_t length, const Waiter& waiter, int64_t nowMs) {
+    uint8_t functionCode = pdu[0];
+    if (IsMergeableRead(pdu, length)) {
+        if (windowEndsMs_ < 0) {
+            windowEndsMs_ = nowMs + options_.windowMs;
+        }
+        pending_[functionCode - 1].push_back(
+            PendingRead{ModbusCodec::ReadU16(pdu + 1), ModbusCodec::ReadU16(pdu + 3), waiter});
+        return;
+    }
+    if (functionCode < 0x01 || functionCode > 0x04) {
+        // A write must not overtake the reads its client sent before it.
+        FlushReads();
+    }
+    Forward(pdu, length, waiter);
+}
+
+void ModbusGateway::Forward(const uint8_t* pdu, std::size_t length, const Waiter& waiter) {
+    uint8_t functionCode = pdu[0];
+    AsyncModbusClient* client = PickBackend();
+    if (!client) {
+        Fail(waiter, functionCode, kPathUnavailable);
+        return;
+    }
+    ++deviceRequests_;
+    client->Transact(pdu, length,
+                     [this, waiter, functionCode](TransactionStatus status, const uint8_t* reply, std::size_t size) {
+                         if (status == TransactionStatus::Ok || status == TransactionStatus::Exception) {
+                             Complete(waiter, reply, size);
+                         } else {
+                             Fail(waiter, functionCode, ExceptionFor(status));
+                         }
+                     });
+}
+
+// Ends the merge window: per table, sorts the held reads by address and
+// sends one device read per run of reads that overlap or lie within maxGap.
+void ModbusGateway::FlushReads() {
+    windowEndsMs_ = -1;
+    for (std::size_t t = 0; t < pending_.size(); ++t) {
+        if (pending_[t].empty()) {
+            continue;
+        }
+        std::vector<PendingRead> reads;
+        reads.swap(pending_[t]);
+        std::stable_sort(reads.begin(), reads.end(), [](const PendingRead& a, const PendingRead& b) {
+            return a.start < b.start;
+        });
+        uint8_t functionCode = static_cast<uint8_t>(t + 1);
+        int limit = MaxReadCount(functionCode);
+        std::size_t first = 0;
+        int spanStart = reads[0].start;
+        int spanEnd = reads[0].start + reads[0].count;
+        for (std::size_t i = 1; i <= reads.size(); ++i) {
+            if (i < reads.size()) {
+                int end = std::max(spanEnd, reads[i].start + reads[i].count);
+                if (reads[i].start <= spanEnd + options_.maxGap && end - spanStart <= limit) {
+                    spanEnd = end;
+                    continue;
+                }
+            }
+            ReadSpan(functionCode, static_cast<uint16_t>(spanStart), static_cast<uint16_t>(spanEnd - spanStart),
+                     std::vector<PendingRead>(reads.begin() + static_cast<std::ptrdiff_t>(first),
+                                              reads.begin() + static_cast<std::ptrdiff_t>(i)),
+                     true);
+            if (i < reads.size()) {
+                first = i;
+                spanStart = reads[i].start;
+                spanEnd = reads[i].start + reads[i].count;
+            }
+        }
+    }
+}
+
+// Reads [start, start + count) once and answers every member from the
+// reply. With `split`, an exception for a span that merged different
+// ranges sends each range again on its own.
+void ModbusGateway::ReadSpan(uint8_t functionCode, uint16_t start, uint16_t count, std::vector<PendingRead> members,
+                             bool split) {
+    mergedReads_ += members.size() - 1;
+    AsyncModbusClient* client = PickBackend();
+    if (!client) {
+        for (const PendingRead& read : members) {
+            Fail(read.waiter, functionCode, kPathUnavailable);
+        }
+        return;
+    }
+    uint8_t request[5] = {functionCode};
+    ModbusCodec::WriteU16(request + 1, start);
+    ModbusCodec::WriteU16(request + 3, count);
+    ++deviceRequests_;
+    client->Transact(request, sizeof(request), [this, functionCode, start, count, members, split](
+                                                   TransactionStatus status, const uint8_t* reply, std::size_t size) {
+        if (status == TransactionStatus::Exception && split &&
+            std::any_of(members.begin(), members.end(), [&members](const PendingRead& read) {
+                return read.start != members[0].start || read.count != members[0].count;
+            })) {
+            mergedReads_ -= members.size() - 1;
+            std::vector<PendingRead> rest = members;
+            while (!rest.empty()) {
+                // Identical ranges still share one request.
+                uint16_t s = rest[0].start;
+                uint16_t c = rest[0].count;
+                auto same = std::stable_partition(rest.begin(), rest.end(), [s, c](const PendingRead& read) {
+                    return read.start == s && read.count == c;
+                });
+                ReadSpan(functionCode, s, c, std::vector<PendingRead>(rest.begin(), same), false);
+                rest.erase(rest.begin(), same);
+            }
+            return;
+        }
+        if (status == TransactionStatus::Exception) {
+            for (const PendingRead& read : members) {
+                Complete(read.waiter, reply, size);
+            }
+            return;
+        }
+        if (status != TransactionStatus::Ok) {
+            for (const PendingRead& read : members) {
+                Fail(read.waiter, functionCode, ExceptionFor(status));
+            }
+            return;
+        }
+        bool bits = IsBitRead(functionCode);
+        std::size_t bytes = bits ? (count + 7u) / 8u : 2u * count;
+        if (size < 2 + bytes || reply[1] != bytes) {
+            for (const PendingRead& read : members) {
+                Fail(read.waiter, functionCode, kDeviceFailure);
+            }
+            return;
+        }
+        uint8_t out[ModbusCodec::kMaxPduLength];
+        for (const PendingRead& read : members) {
+            std::size_t offset = read.start - start;
+            out[0] = functionCode;
+            if (bits) {
+                out[1] = static_cast<uint8_t>((read.count + 7) / 8);
+                std::memset(out + 2, 0, out[1]);
+                for (std::size_t i = 0; i < read.count; ++i) {
+                    std::size_t bit = offset + i;
+                    if ((reply[2 + bit / 8] >> (bit % 8)) & 1) {
+                        out[2 + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+                    }
+                }
+            } else {
+                out[1] = static_cast<uint8_t>(2 * read.count);
+                std::memcpy(out + 2, reply + 2 + 2 * offset, out[1]);
+            }
+            Complete(read.waiter, out, 2u + out[1]);
+        }
+    });
+}
+
+void ModbusGateway::Complete(const Waiter& waiter, const uint8_t* pdu, std::size_t length) {
+    if (static_cast<std::size_t>(waiter.fd) >= connections_.size()) {
+        return;
+    }
+    Connection& conn = *connections_[waiter.fd];
+    if (!conn.open || conn.generation != waiter.generation) {
+        return;   // the client went away meanwhile
+    }
+    Reply& reply = conn.replies[waiter.sequence - conn.firstSequence];
+    reply.done = true;
+    reply.length = std::min(length, reply.pdu.size());
+    std::memcpy(reply.pdu.data(), pdu, reply.length);
+    if (conn.writePending && waiter.sequence == conn.writeSequence) {
+        conn.writePending = false;
+    }
+    if (!conn.dirty) {
+        conn.dirty = true;
+        dirty_.push_back(waiter.fd);
+    }
+}
+
+void ModbusGateway::Fail(const Waiter& waiter, uint8_t functionCode, uint8_t exceptionCode) {
+    uint8_t pdu[2] = {static_cast<uint8_t>(functionCode | 0x80), exceptionCode};
+    Complete(waiter, pdu, sizeof(pdu));
+}
+
+// The connected device connection with the least outstanding work.
+AsyncModbusClient* ModbusGateway::PickBackend() {
+    AsyncModbusClient* best = nullptr;
+    for (Backend& backend : backends_) {
+        AsyncModbusClient* client = backend.client.get();
+        if (client && client->Connected() &&
+            (!best || client->InFlight() + client->Queued() < best->InFlight() + best->Queued())) {
+            best = client;
+        }
+    }
+    return best;
+}
+
+// Held reads go out once their window has passed and a device connection
+// has room in its pipeline. While the device is busy they keep collecting,
+// so a slow device gets fewer, larger reads rather than a queue of small
+// ones. Without any connection they go out at once and fail.
+bool ModbusGateway::DeviceReady() {
+    AsyncModbusClient* client = PickBackend();
+    return !client || client->InFlight() + client->Queued() < options_.pipelineDepth;
+}
+
+// Expires overdue device requests and reconnects with backoff, as PollEngine does.
+void ModbusGateway::Maintain(int64_t nowMs) {
+    for (std::size_t b = 0; b < backends_.size(); ++b) {
+        Backend& backend = backends_[b];
+        if (backend.client && backend.client->Connected()) {
+            if (!backend.client->Connecting()) {
+                backend.backoffMs = 0;
+            }
+            backend.client->CheckTimeouts(nowMs);
+        } else if (nowMs >= backend.reconnectAtMs) {
+            backend.backoffMs = std::min(std::max(backend.backoffMs * 2, kMinBackoffMs), kMaxBackoffMs);
+            backend.reconnectAtMs = nowMs + backend.backoffMs;
+            backend.registeredFd = -1;   // the new socket may reuse the old number
+            try {
+                if (!backend.client) {
+                    backend.client = std::make_unique<AsyncModbusClient>(
+                        options_.deviceAddress.c_str(), options_.devicePort, options_.pipelineDepth,
+                        options_.timeoutMs, options_.unitId);
+                } else {
+                    backend.client->Reconnect();
+                }
+            } catch (const std::exception&) {
+                // Try again after the backoff.
+            }
+        }
+    }
+}
+
+void ModbusGateway::Watch(std::size_t b) {
+    Backend& backend = backends_[b];
+    int fd = backend.client ? backend.client->Fd() : -1;
+    if (fd < 0) {
+        backend.registeredFd = -1;
+        return;
+    }
+    bool wantsWrite = backend.client->WantsWrite();
+    if (fd == backend.registeredFd && wantsWrite == backend.watchingWrite) {
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (wantsWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.u64 = kBackendToken + b;
+    epoll_ctl(epollFd_, fd == backend.registeredFd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    backend.registeredFd = fd;
+    backend.watchingWrite = wantsWrite;
+}
@@ -1,47 +1,435 @@
 #include "ModbusServer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
 
-ModbusServer::ModbusServer(const char* address, int port) : ctx_(nullptr), mapping_(nullptr), serverSocket_(-1) {
+namespace {
+constexpr int kListenBacklog = SOMAXCONN;
+constexpr int kMaxEvents = 256;
+// Stop answering a connection's requests once this much output is queued.
+constexpr std::size_t kMaxPendingOutput = 64 * 1024;
+
+constexpr uint8_t kIllegalDataAddress = 0x02;
+constexpr uint8_t kIllegalDataValue = 0x03;
+
+// Exception code for a request that is staged or committed around
+// modbus_reply() but would not be carried out, or 0 if it will be (or is
+// not one of those). Covers the limits libmodbus checks, and like
+// ModbusCodec::Serve() also wants the PDU length to match, so libmodbus
+// never reads data past the end of the frame.
+uint8_t RequestException(const uint8_t* pdu, std::size_t length) {
+    std::size_t maxQuantity = 0;
+    std::size_t expectedLength = 5;
+    switch (pdu[0]) {
+        case 0x01:
+        case 0x02:
+            maxQuantity = 2000;
+            break;
+        case 0x03:
+        case 0x04:
+            maxQuantity = 125;
+            break;
+        case 0x05:
+        case 0x06:
+            break;
+        case 0x0F:
+            maxQuantity = 1968;
+            expectedLength = length >= 6 ? 6u + pdu[5] : 6;
+            break;
+        case 0x10:
+            maxQuantity = 123;
+            expectedLength = length >= 6 ? 6u + pdu[5] : 6;
+            break;
+        case 0x16:
+            expectedLength = 7;
+            break;
+        case 0x17:
+            maxQuantity = 125;
+            expectedLength = length >= 10 ? 10u + pdu[9] : 10;
+            break;
+        default:
+            return 0;
+    }
+    if (length != expectedLength) {
+        return kIllegalDataValue;
+    }
+    std::size_t address = ModbusCodec::ReadU16(pdu + 1);
+    std::size_t quantity = ModbusCodec::ReadU16(pdu + 3);   // the value, for single writes
+    if (maxQuantity != 0) {
+        if (quantity == 0 || quantity > maxQuantity) {
+            return kIllegalDataValue;
+        }
+        if (address + quantity > RegisterMap::kTableSize) {
+            return kIllegalDataAddress;
+        }
+    } else if (address >= RegisterMap::kTableSize) {
+        return kIllegalDataAddress;
+    }
+    switch (pdu[0]) {
+        case 0x05:
+            return quantity == 0xFF00 || quantity == 0x0000 ? 0 : kIllegalDataValue;
+        case 0x0F:
+            return pdu[5] * 8u < quantity ? kIllegalDataValue : 0;
+        case 0x10:
+            return pdu[5] != quantity * 2 ? kIllegalDataValue : 0;
+        case 0x17: {
+            std::size_t writeAddress = ModbusCodec::ReadU16(pdu + 5);
+            std::size_t writeCount = ModbusCodec::ReadU16(pdu + 7);
+            if (writeCount == 0 || writeCount > 121 || pdu[9] != writeCount * 2) {
+                return kIllegalDataValue;
+            }
+            return writeAddress + writeCount > RegisterMap::kTableSize ? kIllegalDataAddress : 0;
+        }
+        default:
+            return 0;
+    }
+}
+}
+
+ModbusServer::ModbusServer(const char* address, int port, std::shared_ptr<RegisterMap> registers)
+    : ctx_(nullptr), mapping_(nullptr), registers_(std::move(registers)), serverSocket_(-1), port_(port),
+      epollFd_(-1), wakeFd_(-1), running_(true), openCount_(0), requests_(0), nativeCodec_(true) {
 
     ctx_ = modbus_new_tcp(address, port);
     if (!ctx_) {
         throw std::runtime_error("Failed to create Modbus TCP context");
     }
 
-    mapping_ = modbus_mapping_new(0, 0, 10, 0);
+    constexpr int kTableSize = static_cast<int>(RegisterMap::kTableSize);
+    mapping_ = modbus_mapping_new(kTableSize, kTableSize, kTableSize, kTableSize);
     if (!mapping_) {
         modbus_free(ctx_);
         throw std::runtime_error("Failed to allocate Modbus mapping");
     }
 
-    // Initialize holding registers
-    for (int i = 0; i < 10; ++i) {
-        mapping_->tab_registers[i] = (i + 1) * 10;   // 10,20,30,...
+    if (!registers_) {
+        registers_ = std::make_shared<RegisterMap>();
+        // Initialize holding registers
+        uint16_t initial[10];
+        for (int i = 0; i < 10; ++i) {
+            initial[i] = static_cast<uint16_t>((i + 1) * 10);   // 10,20,30,...
+        }
+        registers_->WriteRegisters(RegisterTable::HoldingRegisters, 0, initial, 10);
     }
 
-    serverSocket_ = modbus_tcp_listen(ctx_, 1);
+    serverSocket_ = modbus_tcp_listen(ctx_, kListenBacklog);
     if (serverSocket_ == -1) {
+        modbus_mapping_free(mapping_);
+        modbus_free(ctx_);
         throw std::runtime_error("Failed to listen on socket");
     }
+    fcntl(serverSocket_, F_SETFL, fcntl(serverSocket_, F_GETFL) | O_NONBLOCK);
+
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0) {
+        if (epollFd_ >= 0) close(epollFd_);
+        if (wakeFd_ >= 0) close(wakeFd_);
+        close(serverSocket_);
+        modbus_mapping_free(mapping_);
+        modbus_free(ctx_);
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = serverSocket_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSocket_, &ev);
+    ev.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
 }
 
 ModbusServer::~ModbusServer() {
+    for (std::size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd] && connections_[fd]->open) {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (wakeFd_ >= 0) close(wakeFd_);
+    if (epollFd_ >= 0) close(epollFd_);
+    if (serverSocket_ >= 0) close(serverSocket_);
     if (mapping_) modbus_mapping_free(mapping_);
     if (ctx_) modbus_free(ctx_);
 }
 
 void ModbusServer::Run() {
-    std::cout << "Modbus TCP Server running on port 5020..." << std::endl;
+    std::cout << "Modbus TCP Server running on port " << port_ << "..." << std::endl;
+
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int ready = epoll_wait(epollFd_, events, kMaxEvents, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == serverSocket_) {
+                AcceptAll();
+            } else if (fd == wakeFd_) {
+                uint64_t value;
+                ssize_t got = read(wakeFd_, &value, sizeof(value));
+                (void)got;
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                CloseConnection(fd);
+            } else if (events[i].events & EPOLLOUT) {
+                OnWritable(fd);
+            } else {
+                OnReadable(fd);
+            }
+        }
+    }
+}
+
+void ModbusServer::Stop() {
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd_, &one, sizeof(one));
+    (void)written;
+}
+
+std::size_t ModbusServer::ConnectionCount() const {
+    return openCount_;
+}
+
+uint64_t ModbusServer::RequestCount() const {
+    return requests_;
+}
+
+RegisterMap& ModbusServer::Registers() {
+    return *registers_;
+}
+
+void ModbusServer::UseNativeCodec(bool enabled) {
+    nativeCodec_ = enabled;
+}
 
+void ModbusServer::AcceptAll() {
     for (;;) {
-        int clientSocket = modbus_tcp_accept(ctx_, &serverSocket_);
-        if (clientSocket == -1) continue;
+        int fd = accept4(serverSocket_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN drains the backlog; EMFILE and friends wait for the next wakeup.
+            return;
+        }
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        // Replies go out through modbus_reply(), which expects a blocking
+        // socket; a client that stops reading must not stall the loop for long.
+        timeval timeout{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 
-        uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
-        int rc = modbus_receive(ctx_, query);
+        if (static_cast<std::size_t>(fd) >= connections_.size()) {
+            connections_.resize(fd + 1);
+        }
+        if (!connections_[fd]) {
+            connections_[fd] = std::make_unique<Connection>();
+        }
+        connections_[fd]->open = true;
+        connections_[fd]->writing = false;
+        connections_[fd]->length = 0;
+        connections_[fd]->output.clear();
+        ++openCount_;
 
-        if (rc > 0) {
-            modbus_reply(ctx_, query, rc, mapping_);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void ModbusServer::OnReadable(int fd) {
+    Connection& conn = *connections_[fd];
+    // Level-triggered: read what fits, serve it, and come back if more is queued.
+    ssize_t received = recv(fd, conn.input + conn.length, sizeof(conn.input) - conn.length, MSG_DONTWAIT);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+        CloseConnection(fd);
+        return;
+    }
+    if (received < 0) {
+        return;
+    }
+    conn.length += static_cast<std::size_t>(received);
+    if (!ServeFrames(fd, conn)) {
+        CloseConnection(fd);
+    }
+}
+
+void ModbusServer::OnWritable(int fd) {
+    Connection& conn = *connections_[fd];
+    if (!Flush(fd, conn) || !ServeFrames(fd, conn)) {
+        CloseConnection(fd);
+    }
+}
+
+// Answers every complete ADU in the buffer and keeps any partial one, or
+// stops early while too many replies are waiting for the socket.
+// Returns false if the stream is not valid Modbus TCP.
+bool ModbusServer::ServeFrames(int fd, Connection& conn) {
+    std::size_t offset = 0;
+    while (!conn.writing && conn.output.size() < kMaxPendingOutput) {
+        ModbusCodec::Frame frame;
+        ModbusCodec::ParseResult parsed = ModbusCodec::Parse(conn.input + offset, conn.length - offset, frame);
+        if (parsed == ModbusCodec::ParseResult::Invalid) {
+            return false;
+        }
+        if (parsed == ModbusCodec::ParseResult::Incomplete) {
+            break;
         }
+        if (nativeCodec_ && ModbusCodec::Handles(frame.pdu[0])) {
+            std::size_t at = conn.output.size();
+            conn.output.resize(at + ModbusCodec::kMaxAduLength);
+            uint8_t* reply = conn.output.data() + at;
+            std::size_t length = ModbusCodec::Serve(*registers_, frame.pdu, frame.pduLength,
+                                                    reply + ModbusCodec::kMbapHeaderLength);
+            ModbusCodec::WriteHeader(reply, frame.transactionId, frame.unitId, length);
+            conn.output.resize(at + ModbusCodec::kMbapHeaderLength + length);
+        } else {
+            // modbus_reply() writes to the socket itself, so earlier replies go first.
+            if (!Flush(fd, conn)) {
+                return false;
+            }
+            if (conn.writing) {
+                break;
+            }
+            // Requests libmodbus would reject are answered here, so the
+            // staging mapping is only committed after a request it carried
+            // out; a rejected one would publish stale values.
+            uint8_t exception = RequestException(frame.pdu, frame.pduLength);
+            if (exception != 0) {
+                uint8_t reply[ModbusCodec::kMbapHeaderLength + 2];
+                ModbusCodec::WriteHeader(reply, frame.transactionId, frame.unitId, 2);
+                reply[ModbusCodec::kMbapHeaderLength] = static_cast<uint8_t>(frame.pdu[0] | 0x80);
+                reply[ModbusCodec::kMbapHeaderLength + 1] = exception;
+                conn.output.insert(conn.output.end(), reply, reply + sizeof(reply));
+            } else {
+                StageRequest(frame.pdu);
+                modbus_set_socket(ctx_, fd);
+                if (modbus_reply(ctx_, conn.input + offset, static_cast<int>(frame.size), mapping_) < 0) {
+                    return false;
+                }
+                CommitRequest(frame.pdu);
+            }
+        }
+        ++requests_;
+        offset += frame.size;
+    }
+    if (offset > 0) {
+        std::memmove(conn.input, conn.input + offset, conn.length - offset);
+        conn.length -= offset;
+    }
+    return Flush(fd, conn);
+}
+
+// Sends queued replies. While the socket is full the connection waits for
+// EPOLLOUT instead of EPOLLIN, which pushes back on a client that sends
+// faster than it reads. Returns false on a socket error.
+bool ModbusServer::Flush(int fd, Connection& conn) {
+    std::size_t sent = 0;
+    while (sent < conn.output.size()) {
+        ssize_t n = send(fd, conn.output.data() + sent, conn.output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    conn.output.erase(conn.output.begin(), conn.output.begin() + static_cast<std::ptrdiff_t>(sent));
+
+    bool writing = !conn.output.empty();
+    if (writing != conn.writing) {
+        epoll_event ev{};
+        ev.events = (writing ? EPOLLOUT : EPOLLIN) | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+        conn.writing = writing;
+    }
+    return true;
+}
+
+// Copies the range a request reads from the register map into the staging
+// mapping. Each copy is one consistent snapshot. The request must have
+// passed RequestException().
+void ModbusServer::StageRequest(const uint8_t* pdu) {
+    uint16_t address = ModbusCodec::ReadU16(pdu + 1);
+    uint16_t count = ModbusCodec::ReadU16(pdu + 3);
+    switch (pdu[0]) {
+        case 0x01:
+            registers_->ReadBits(RegisterTable::Coils, address, mapping_->tab_bits + address, count);
+            break;
+        case 0x02:
+            registers_->ReadBits(RegisterTable::DiscreteInputs, address, mapping_->tab_input_bits + address, count);
+            break;
+        case 0x03:
+        case 0x17:   // read/write multiple registers: the read range comes first
+            registers_->ReadRegisters(RegisterTable::HoldingRegisters, address,
+                                      mapping_->tab_registers + address, count);
+            break;
+        case 0x04:
+            registers_->ReadRegisters(RegisterTable::InputRegisters, address,
+                                      mapping_->tab_input_registers + address, count);
+            break;
+        case 0x16:   // mask write reads the current value
+            registers_->ReadRegisters(RegisterTable::HoldingRegisters, address,
+                                      mapping_->tab_registers + address, 1);
+            break;
+        default:
+            break;
+    }
+}
+
+// Publishes whatever a write request changed in the staging mapping, once
+// modbus_reply() has carried it out.
+void ModbusServer::CommitRequest(const uint8_t* pdu) {
+    uint16_t address = ModbusCodec::ReadU16(pdu + 1);
+    uint16_t count = ModbusCodec::ReadU16(pdu + 3);
+    switch (pdu[0]) {
+        case 0x05:
+            registers_->WriteBits(RegisterTable::Coils, address, mapping_->tab_bits + address, 1);
+            break;
+        case 0x0F:
+            registers_->WriteBits(RegisterTable::Coils, address, mapping_->tab_bits + address, count);
+            break;
+        case 0x06:
+        case 0x16:
+            registers_->WriteRegisters(RegisterTable::HoldingRegisters, address,
+                                       mapping_->tab_registers + address, 1);
+            break;
+        case 0x10:
+            registers_->WriteRegisters(RegisterTable::HoldingRegisters, address,
+                                       mapping_->tab_registers + address, count);
+            break;
+        case 0x17: {
+            uint16_t writeAddress = ModbusCodec::ReadU16(pdu + 5);
+            uint16_t writeCount = ModbusCodec::ReadU16(pdu + 7);
+            registers_->WriteRegisters(RegisterTable::HoldingRegisters, writeAddress,
+                                       mapping_->tab_registers + writeAddress, writeCount);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void ModbusServer::CloseConnection(int fd) {
+    Connection& conn = *connections_[fd];
+    if (!conn.open) {
+        return;
     }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conn.open = false;
+    conn.writing = false;
+    conn.length = 0;
+    conn.output.clear();
+    --openCount_;
 }
@@ -0,0 +1,256 @@
+#include "PollEngine.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+constexpr int kMaxEvents = 256;
+constexpr uint64_t kWakeToken = UINT64_MAX;
+constexpr int64_t kMinBackoffMs = 500;
+constexpr int64_t kMaxBackoffMs = 30000;
+}
+
+PollEngine::PollEngine(std::size_t threads) : running_(false) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+PollEngine::~PollEngine() {
+    Stop();
+    for (auto& worker : workers_) {
+        if (worker->wakeFd >= 0) close(worker->wakeFd);
+        if (worker->epollFd >= 0) close(worker->epollFd);
+    }
+}
+
+std::size_t PollEngine::AddDevice(const char* address, int port, uint8_t unitId, std::size_t pipelineDepth,
+                                  int timeoutMs) {
+    auto device = std::make_unique<Device>();
+    device->address = address;
+    device->port = port;
+    device->unitId = unitId;
+    device->pipelineDepth = pipelineDepth;
+    device->timeoutMs = timeoutMs;
+    devices_.push_back(std::move(device));
+    return devices_.size() - 1;
+}
+
+std::size_t PollEngine::AddGroup(std::size_t device, std::shared_ptr<const ReadPlan> plan, int64_t periodMs,
+                                 GroupCallback callback) {
+    if (device >= devices_.size() || periodMs < kTickMs) {
+        throw std::runtime_error("Invalid poll group");
+    }
+    auto group = std::make_unique<Group>();
+    group->device = device;
+    group->values.resize(plan->ValueCount());
+    group->plan = std::move(plan);
+    group->periodMs = periodMs;
+    group->callback = std::move(callback);
+    groups_.push_back(std::move(group));
+    return groups_.size() - 1;
+}
+
+void PollEngine::Start() {
+    if (running_) {
+        return;
+    }
+    for (std::size_t d = 0; d < devices_.size(); ++d) {
+        workers_[d % workers_.size()]->devices.push_back(d);
+    }
+    for (auto& worker : workers_) {
+        worker->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        worker->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker->epollFd < 0 || worker->wakeFd < 0) {
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kWakeToken;
+        epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->wakeFd, &ev);
+        worker->wheel.assign(kWheelSlots, {});
+    }
+    running_ = true;
+    for (auto& worker : workers_) {
+        Worker* w = worker.get();
+        worker->thread = std::thread([this, w]() { Run(*w); });
+    }
+}
+
+void PollEngine::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    for (auto& worker : workers_) {
+        uint64_t one = 1;
+        ssize_t written = write(worker->wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+PollGroupStats PollEngine::Stats(std::size_t group) const {
+    const Group& g = *groups_[group];
+    return PollGroupStats{g.cycles.load(), g.failures.load(), g.overruns.load(), g.lastCycleMs.load(),
+                          g.maxCycleMs.load()};
+}
+
+void PollEngine::Run(Worker& worker) {
+    int64_t now = AsyncModbusClient::NowMs();
+    worker.tick = now / kTickMs;
+    for (std::size_t g = 0; g < groups_.size(); ++g) {
+        if (workers_[groups_[g]->device % workers_.size()].get() != &worker) {
+            continue;
+        }
+        // Spread groups over their period instead of firing them all at once.
+        Group& group = *groups_[g];
+        group.dueMs = now + static_cast<int64_t>((g * 2654435761u) % static_cast<uint64_t>(group.periodMs));
+        Schedule(worker, g);
+    }
+    Maintain(worker, now);
+
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int64_t wait = (worker.tick + 1) * kTickMs - AsyncModbusClient::NowMs();
+        int ready = epoll_wait(worker.epollFd, events, kMaxEvents, static_cast<int>(std::max<int64_t>(wait, 0)));
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.u64 == kWakeToken) {
+                uint64_t value;
+                ssize_t got = read(worker.wakeFd, &value, sizeof(value));
+                (void)got;
+                continue;
+            }
+            std::size_t d = static_cast<std::size_t>(events[i].data.u64);
+            AsyncModbusClient& client = *devices_[d]->client;
+            if (events[i].events & EPOLLOUT) {
+                client.OnWritable();
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                client.OnReadable();
+            }
+            Watch(worker, d);
+        }
+        now = AsyncModbusClient::NowMs();
+        if (now / kTickMs > worker.tick) {
+            RunDue(worker, now);
+            Maintain(worker, now);
+        }
+    }
+}
+
+void PollEngine::Schedule(Worker& worker, std::size_t group) {
+    int64_t tick = std::max(groups_[group]->dueMs / kTickMs, worker.tick + 1);
+    worker.wheel[static_cast<std::size_t>(tick) % kWheelSlots].push_back(group);
+}
+
+// Fires every group due up to now. A slot holds groups for several laps of
+// the wheel; those due on a later lap stay where they are.
+void PollEngine::RunDue(Worker& worker, int64_t nowMs) {
+    std::vector<std::size_t> slot;
+    while (worker.tick < nowMs / kTickMs) {
+        ++worker.tick;
+        std::vector<std::size_t>& entries = worker.wheel[static_cast<std::size_t>(worker.tick) % kWheelSlots];
+        slot.swap(entries);
+        for (std::size_t g : slot) {
+            Group& group = *groups_[g];
+            if (group.dueMs / kTickMs > worker.tick) {
+                entries.push_back(g);
+                continue;
+            }
+            StartCycle(g, nowMs);
+            group.dueMs += group.periodMs;
+            if (group.dueMs <= nowMs) {
+                // The thread fell behind by whole periods: skip them rather than burst.
+                int64_t missed = (nowMs - group.dueMs) / group.periodMs + 1;
+                group.overruns += static_cast<uint64_t>(missed);
+                group.dueMs += missed * group.periodMs;
+            }
+            Schedule(worker, g);
+        }
+        slot.clear();
+    }
+}
+
+void PollEngine::StartCycle(std::size_t g, int64_t nowMs) {
+    Group& group = *groups_[g];
+    if (group.running) {
+        ++group.overruns;
+        return;
+    }
+    Device& device = *devices_[group.device];
+    if (!device.client || !device.client->Connected()) {
+        ++group.failures;
+        group.callback(TransactionStatus::Disconnected, nullptr, 0);
+        return;
+    }
+    group.running = true;
+    group.startedMs = nowMs;
+    group.plan->Submit(*device.client, group.values.data(), [this, g](TransactionStatus status) {
+        Group& done = *groups_[g];
+        done.running = false;
+        uint32_t elapsed = static_cast<uint32_t>(AsyncModbusClient::NowMs() - done.startedMs);
+        ++done.cycles;
+        done.lastCycleMs = elapsed;
+        if (elapsed > done.maxCycleMs) {
+            done.maxCycleMs = elapsed;
+        }
+        if (status == TransactionStatus::Ok) {
+            devices_[done.device]->backoffMs = 0;
+        } else {
+            ++done.failures;
+        }
+        done.callback(status, done.values.data(), done.values.size());
+    });
+}
+
+// Expires overdue requests and reconnects devices whose backoff has passed.
+void PollEngine::Maintain(Worker& worker, int64_t nowMs) {
+    for (std::size_t d : worker.devices) {
+        Device& device = *devices_[d];
+        if (device.client && device.client->Connected()) {
+            device.client->CheckTimeouts(nowMs);
+        } else if (nowMs >= device.reconnectAtMs) {
+            device.backoffMs = std::min(std::max(device.backoffMs * 2, kMinBackoffMs), kMaxBackoffMs);
+            device.reconnectAtMs = nowMs + device.backoffMs;
+            device.registeredFd = -1;   // the new socket may reuse the old number
+            try {
+                if (!device.client) {
+                    device.client = std::make_unique<AsyncModbusClient>(
+                        device.address.c_str(), device.port, device.pipelineDepth, device.timeoutMs, device.unitId);
+                } else {
+                    device.client->Reconnect();
+                }
+            } catch (const std::exception&) {
+                // Try again after the backoff.
+            }
+        }
+        Watch(worker, d);
+    }
+}
+
+// Keeps the epoll registration in step with the client's socket. A closed
+// socket has already left the epoll set, so only new ones are added.
+void PollEngine::Watch(Worker& worker, std::size_t d) {
+    Device& device = *devices_[d];
+    int fd = device.client ? device.client->Fd() : -1;
+    if (fd < 0) {
+        device.registeredFd = -1;
+        return;
+    }
+    bool wantsWrite = device.client->WantsWrite();
+    if (fd == device.registeredFd && wantsWrite == device.watchingWrite) {
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (wantsWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.u64 = d;
+    epoll_ctl(worker.epollFd, fd == device.registeredFd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    device.registeredFd = fd;
+    device.watchingWrite = wantsWrite;
+}
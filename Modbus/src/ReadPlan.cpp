@@ -0,0 +1,143 @@
+#include "ReadPlan.hpp"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+std::size_t MaxBlockLength(RegisterTable table) {
+    bool bits = table == RegisterTable::Coils || table == RegisterTable::DiscreteInputs;
+    return bits ? AsyncModbusClient::kMaxReadBits : AsyncModbusClient::kMaxReadRegisters;
+}
+}
+
+ReadPlan::ReadPlan(const std::vector<Tag>& tags, uint16_t maxGap) : valueCount_(0) {
+    valueOffsets_.reserve(tags.size());
+    for (const Tag& tag : tags) {
+        if (tag.width == 0 || tag.width > MaxBlockLength(tag.table) ||
+            static_cast<std::size_t>(tag.address) + tag.width > RegisterMap::kTableSize) {
+            throw std::runtime_error("Invalid tag range");
+        }
+        valueOffsets_.push_back(static_cast<uint32_t>(valueCount_));
+        valueCount_ += tag.width;
+    }
+
+    std::vector<uint32_t> order(tags.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&tags](uint32_t a, uint32_t b) {
+        if (tags[a].table != tags[b].table) return tags[a].table < tags[b].table;
+        return tags[a].address < tags[b].address;
+    });
+
+    // Scanning in address order and starting a new block only when the next
+    // tag cannot join the current one gives the fewest blocks for the gap
+    // and length limits.
+    std::size_t end = 0;   // one past the last entry the open block covers
+    for (uint32_t index : order) {
+        const Tag& tag = tags[index];
+        std::size_t tagEnd = tag.address + static_cast<std::size_t>(tag.width);
+        bool join = false;
+        if (!blocks_.empty()) {
+            const ReadBlock& open = blocks_.back();
+            join = open.table == tag.table && tag.address <= end + maxGap &&
+                   std::max(end, tagEnd) - open.start <= MaxBlockLength(tag.table);
+        }
+        if (join) {
+            end = std::max(end, tagEnd);
+            blocks_.back().count = static_cast<uint16_t>(end - blocks_.back().start);
+        } else {
+            blocks_.push_back(ReadBlock{tag.table, tag.address, tag.width});
+            firstSlot_.push_back(static_cast<uint32_t>(slots_.size()));
+            end = tagEnd;
+        }
+        slots_.push_back(Slot{static_cast<uint16_t>(tag.address - blocks_.back().start), tag.width,
+                              valueOffsets_[index]});
+    }
+    firstSlot_.push_back(static_cast<uint32_t>(slots_.size()));
+}
+
+const std::vector<ReadBlock>& ReadPlan::Blocks() const {
+    return blocks_;
+}
+
+std::size_t ReadPlan::TagCount() const {
+    return valueOffsets_.size();
+}
+
+std::size_t ReadPlan::ValueCount() const {
+    return valueCount_;
+}
+
+std::size_t ReadPlan::ValueOffset(std::size_t tag) const {
+    return valueOffsets_[tag];
+}
+
+void ReadPlan::Scatter(std::size_t block, const uint16_t* data, uint16_t* values) const {
+    ScatterBlock(block, data, values);
+}
+
+void ReadPlan::Scatter(std::size_t block, const uint8_t* bits, uint16_t* values) const {
+    ScatterBlock(block, bits, values);
+}
+
+template <typename T>
+void ReadPlan::ScatterBlock(std::size_t block, const T* data, uint16_t* values) const {
+    for (uint32_t s = firstSlot_[block]; s < firstSlot_[block + 1]; ++s) {
+        const Slot& slot = slots_[s];
+        for (uint16_t i = 0; i < slot.width; ++i) {
+            values[slot.value + i] = data[slot.offset + i];
+        }
+    }
+}
+
+void ReadPlan::Submit(AsyncModbusClient& client, uint16_t* values,
+                      std::function<void(TransactionStatus)> done) const {
+    struct Cycle {
+        std::size_t remaining;
+        TransactionStatus status;
+        std::function<void(TransactionStatus)> done;
+    };
+    auto cycle = std::make_shared<Cycle>(Cycle{blocks_.size(), TransactionStatus::Ok, std::move(done)});
+    if (blocks_.empty()) {
+        cycle->done(TransactionStatus::Ok);
+        return;
+    }
+    auto finish = [cycle](TransactionStatus status) {
+        if (cycle->status == TransactionStatus::Ok) {
+            cycle->status = status;
+        }
+        if (--cycle->remaining == 0) {
+            cycle->done(cycle->status);
+        }
+    };
+
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+        const ReadBlock& block = blocks_[b];
+        auto onRegisters = [this, b, values, finish](TransactionStatus status, const uint16_t* data, std::size_t) {
+            if (status == TransactionStatus::Ok) {
+                Scatter(b, data, values);
+            }
+            finish(status);
+        };
+        auto onBits = [this, b, values, finish](TransactionStatus status, const uint8_t* bits, std::size_t) {
+            if (status == TransactionStatus::Ok) {
+                Scatter(b, bits, values);
+            }
+            finish(status);
+        };
+        switch (block.table) {
+            case RegisterTable::Coils:
+                client.ReadCoils(block.start, block.count, onBits);
+                break;
+            case RegisterTable::DiscreteInputs:
+                client.ReadDiscreteInputs(block.start, block.count, onBits);
+                break;
+            case RegisterTable::HoldingRegisters:
+                client.ReadHoldingRegisters(block.start, block.count, onRegisters);
+                break;
+            case RegisterTable::InputRegisters:
+                client.ReadInputRegisters(block.start, block.count, onRegisters);
+                break;
+        }
+    }
+}
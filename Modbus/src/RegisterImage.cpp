@@ -0,0 +1,224 @@
+#include "RegisterImage.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+constexpr std::size_t kNoSubscription = std::numeric_limits<std::size_t>::max();
+}
+
+RegisterImage::RegisterImage(std::size_t size)
+    : values_(size, 0), unseen_((size + 63) / 64, ~uint64_t{0}), unseenCount_(size),
+      notifying_(false), running_(kNoSubscription), buckets_((size + kBucketSize - 1) / kBucketSize),
+      stamp_(0) {
+    if (size % 64 != 0) {
+        unseen_.back() = (uint64_t{1} << (size % 64)) - 1;
+    }
+}
+
+std::size_t RegisterImage::Subscribe(std::size_t index, std::size_t count, uint16_t deadband,
+                                     ChangeCallback callback) {
+    if (count == 0 || index + count > values_.size()) {
+        throw std::runtime_error("Invalid subscription range");
+    }
+    std::size_t id = subscriptions_.size() + added_.size();
+    Subscription s{index, count, deadband, true, false, 0, std::vector<uint16_t>(count), std::move(callback)};
+    if (notifying_) {
+        // Growing subscriptions_ now could move the callback that is running.
+        added_.push_back(std::move(s));
+        return id;
+    }
+    subscriptions_.push_back(std::move(s));
+    AddToBuckets(id);
+    return id;
+}
+
+void RegisterImage::AddToBuckets(std::size_t id) {
+    const Subscription& s = subscriptions_[id];
+    for (std::size_t b = s.index / kBucketSize; b <= (s.index + s.count - 1) / kBucketSize; ++b) {
+        buckets_[b].push_back(static_cast<uint32_t>(id));
+    }
+}
+
+void RegisterImage::Unsubscribe(std::size_t subscription) {
+    if (subscription >= subscriptions_.size()) {
+        Subscription& pending = added_.at(subscription - subscriptions_.size());
+        pending.active = false;
+        pending.callback = nullptr;
+        return;
+    }
+    Subscription& s = subscriptions_[subscription];
+    if (!s.active) {
+        return;
+    }
+    s.active = false;
+    if (subscription != running_) {
+        s.callback = nullptr;   // otherwise Notify() drops it once the call returns
+    }
+    for (std::size_t b = s.index / kBucketSize; b <= (s.index + s.count - 1) / kBucketSize; ++b) {
+        std::vector<uint32_t>& bucket = buckets_[b];
+        bucket.erase(std::find(bucket.begin(), bucket.end(), static_cast<uint32_t>(subscription)));
+    }
+}
+
+const uint16_t* RegisterImage::Values() const {
+    return values_.data();
+}
+
+std::size_t RegisterImage::Size() const {
+    return values_.size();
+}
+
+std::size_t RegisterImage::Update(std::size_t index, const uint16_t* values, std::size_t count) {
+    if (index + count > values_.size()) {
+        throw std::runtime_error("Update outside the register image");
+    }
+    changed_.clear();
+    FindChanges(index, values, count);
+    if (unseenCount_ > 0 && TakeUnseen(index, count)) {
+        // First values for part of this range: report all of it once.
+        changed_.assign(1, Range{index, index + count});
+    }
+    std::memcpy(values_.data() + index, values, count * sizeof(uint16_t));
+    if (changed_.empty()) {
+        return 0;
+    }
+
+    // Collect each affected subscription once, then let it check its deadband.
+    ++stamp_;
+    touched_.clear();
+    std::size_t changedCount = 0;
+    for (const Range& range : changed_) {
+        changedCount += range.end - range.begin;
+        for (std::size_t b = range.begin / kBucketSize; b <= (range.end - 1) / kBucketSize; ++b) {
+            for (uint32_t id : buckets_[b]) {
+                Subscription& s = subscriptions_[id];
+                if (s.stamp != stamp_ && s.index < range.end && range.begin < s.index + s.count) {
+                    s.stamp = stamp_;
+                    touched_.push_back(id);
+                }
+            }
+        }
+    }
+    notifying_ = true;
+    for (std::size_t i = 0; i < touched_.size(); ++i) {
+        Notify(touched_[i]);
+    }
+    notifying_ = false;
+    for (Subscription& s : added_) {
+        subscriptions_.push_back(std::move(s));
+        if (subscriptions_.back().active) {
+            AddToBuckets(subscriptions_.size() - 1);
+        }
+    }
+    added_.clear();
+    return changedCount;
+}
+
+// Appends the runs of entries whose new value differs from the image.
+void RegisterImage::FindChanges(std::size_t index, const uint16_t* values, std::size_t count) {
+    const uint16_t* current = values_.data() + index;
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        uint32_t differ = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)));
+        while (differ != 0) {
+            unsigned lane = static_cast<unsigned>(__builtin_ctz(differ)) / 2;
+            differ &= ~(3u << (lane * 2));
+            MarkChanged(index + i + lane);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        uint32_t differ = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(a, b))) & 0xFFFFu;
+        while (differ != 0) {
+            unsigned lane = static_cast<unsigned>(__builtin_ctz(differ)) / 2;
+            differ &= ~(3u << (lane * 2));
+            MarkChanged(index + i + lane);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (current[i] != values[i]) {
+            MarkChanged(index + i);
+        }
+    }
+}
+
+void RegisterImage::MarkChanged(std::size_t at) {
+    if (!changed_.empty() && changed_.back().end == at) {
+        changed_.back().end = at + 1;
+    } else {
+        changed_.push_back(Range{at, at + 1});
+    }
+}
+
+// Clears the never-written bits for the range; true if any were set.
+bool RegisterImage::TakeUnseen(std::size_t index, std::size_t count) {
+    bool any = false;
+    for (std::size_t i = index; i < index + count;) {
+        std::size_t bit = i % 64;
+        std::size_t span = std::min<std::size_t>(64 - bit, index + count - i);
+        uint64_t mask = (span == 64 ? ~uint64_t{0} : ((uint64_t{1} << span) - 1)) << bit;
+        uint64_t& word = unseen_[i / 64];
+        if (word & mask) {
+            unseenCount_ -= static_cast<std::size_t>(__builtin_popcountll(word & mask));
+            word &= ~mask;
+            any = true;
+        }
+        i += span;
+    }
+    return any;
+}
+
+// Entries that moved less than the deadband keep their last reported value,
+// so slow drift is still reported once it adds up. Only entries in changed_
+// can have moved, so after the first report only those are compared.
+void RegisterImage::Notify(std::size_t id) {
+    Subscription& s = subscriptions_[id];
+    if (!s.active) {
+        return;   // unsubscribed by an earlier callback of this Update()
+    }
+    const uint16_t* current = values_.data() + s.index;
+    std::size_t first = s.count;
+    std::size_t last = 0;
+    auto compare = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            uint16_t delta = current[i] > s.reported[i] ? current[i] - s.reported[i] : s.reported[i] - current[i];
+            if (!s.primed || delta > s.deadband) {
+                s.reported[i] = current[i];
+                first = std::min(first, i);
+                last = i;
+            }
+        }
+    };
+    if (!s.primed) {
+        compare(0, s.count);
+    } else {
+        std::size_t end = s.index + s.count;
+        auto range = std::lower_bound(changed_.begin(), changed_.end(), s.index,
+                                      [](const Range& r, std::size_t at) { return r.end <= at; });
+        for (; range != changed_.end() && range->begin < end; ++range) {
+            compare(std::max(range->begin, s.index) - s.index, std::min(range->end, end) - s.index);
+        }
+    }
+    s.primed = true;
+    if (first < s.count) {
+        running_ = id;
+        s.callback(s.index + first, current + first, last - first + 1);
+        running_ = kNoSubscription;
+        Subscription& after = subscriptions_[id];
+        if (!after.active) {
+            after.callback = nullptr;
+        }
+    }
+}
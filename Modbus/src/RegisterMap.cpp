@@ -0,0 +1,92 @@
+#include "RegisterMap.hpp"
+#include <algorithm>
+#include <type_traits>
+
+RegisterMap::RegisterMap() {
+    for (Table& table : tables_) {
+        table.values = std::make_unique<std::atomic<uint16_t>[]>(kTableSize);
+        table.stripes = std::make_unique<std::atomic<uint32_t>[]>(kStripes);
+        for (std::size_t i = 0; i < kTableSize; ++i) {
+            table.values[i].store(0, std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < kStripes; ++i) {
+            table.stripes[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void RegisterMap::WriteRegisters(RegisterTable table, uint16_t address, const uint16_t* values,
+                                 std::size_t count) {
+    Write(table, address, values, count);
+}
+
+void RegisterMap::WriteBits(RegisterTable table, uint16_t address, const uint8_t* values, std::size_t count) {
+    Write(table, address, values, count);
+}
+
+void RegisterMap::ReadRegisters(RegisterTable table, uint16_t address, uint16_t* out, std::size_t count) const {
+    Read(table, address, out, count);
+}
+
+void RegisterMap::ReadBits(RegisterTable table, uint16_t address, uint8_t* out, std::size_t count) const {
+    Read(table, address, out, count);
+}
+
+template <typename T>
+void RegisterMap::Write(RegisterTable which, uint16_t address, const T* values, std::size_t count) {
+    count = std::min(count, kTableSize - address);
+    if (count == 0) {
+        return;
+    }
+    Table& table = tables_[static_cast<std::size_t>(which)];
+    std::size_t first = address / kStripeSize;
+    std::size_t last = (address + count - 1) / kStripeSize;
+
+    std::lock_guard<std::mutex> lock(table.writeMutex);
+    for (std::size_t s = first; s <= last; ++s) {
+        table.stripes[s].store(table.stripes[s].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < count; ++i) {
+        uint16_t value = std::is_same<T, uint8_t>::value ? (values[i] != 0) : values[i];
+        table.values[address + i].store(value, std::memory_order_relaxed);
+    }
+    for (std::size_t s = first; s <= last; ++s) {
+        table.stripes[s].store(table.stripes[s].load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+}
+
+template <typename T>
+void RegisterMap::Read(RegisterTable which, uint16_t address, T* out, std::size_t count) const {
+    count = std::min(count, kTableSize - address);
+    if (count == 0) {
+        return;
+    }
+    const Table& table = tables_[static_cast<std::size_t>(which)];
+    std::size_t first = address / kStripeSize;
+    std::size_t last = (address + count - 1) / kStripeSize;
+
+    // A read spans at most a handful of stripes; remember what each said.
+    uint32_t before[kTableSize / kStripeSize + 1];
+    for (;;) {
+        bool writing = false;
+        for (std::size_t s = first; s <= last; ++s) {
+            before[s - first] = table.stripes[s].load(std::memory_order_acquire);
+            writing = writing || (before[s - first] & 1) != 0;
+        }
+        if (writing) {
+            continue;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<T>(table.values[address + i].load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool moved = false;
+        for (std::size_t s = first; s <= last; ++s) {
+            moved = moved || table.stripes[s].load(std::memory_order_relaxed) != before[s - first];
+        }
+        if (!moved) {
+            return;
+        }
+    }
+}
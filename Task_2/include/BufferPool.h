@@ -0,0 +1,28 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Recycles fixed-size chunks so connections only hold memory while they
+// have partial input or unsent output.
+class BufferPool {
+public:
+    explicit BufferPool(std::size_t chunk_size);
+    ~BufferPool() = default;
+
+    char* acquire();
+    void release(char* chunk);
+
+    [[nodiscard]] std::size_t chunkSize() const;
+    [[nodiscard]] std::size_t allocated() const;
+    [[nodiscard]] std::size_t available() const;
+
+private:
+    std::size_t chunk_size_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    std::vector<char*> free_;
+};
+
+#endif
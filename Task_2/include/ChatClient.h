@@ -2,14 +2,25 @@
 #define CHAT_CLIENT_H
 
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <netinet/in.h>
 #include <string>
+#include <string_view>
 #include <thread>
+#include "Fragment.h"
 #include "Message.h"
+#include "ReliableChannel.h"
+
+enum class ClientMode {
+    Unicast,     // fire-and-forget datagrams from the server
+    Reliable,    // sequenced and acknowledged chat traffic
+    Multicast    // room traffic from the room's multicast group
+};
 
 class ChatClient {
 public:
-    ChatClient(const std::string& serverIp, int serverPort);
+    ChatClient(const std::string& serverIp, int serverPort, ClientMode mode = ClientMode::Unicast);
     ~ChatClient();
 
     void run(); 
@@ -22,10 +33,30 @@ private:
     std::string current_room_;
     std::atomic<bool> running_{true};
     std::thread receiver_thread_;
+    std::unique_ptr<ReliableChannel> reliable_;   // null in fire-and-forget mode
+    std::mutex reliable_mutex_;
+    std::string heartbeat_;                       // PING for the current room, empty if none
+    std::mutex heartbeat_mutex_;
+    bool multicast_{false};
+    int group_fd_{-1};                            // bound to the group port once a group is known
+    int group_port_{0};
+    ip_mreq group_{};
+    bool in_group_{false};
+    std::string group_room_;                      // room whose GROUP reply is expected
+    std::mutex group_mutex_;
+    Reassembler reassembly_;                      // receiver thread only
+    uint32_t next_message_id_{0};
 
     void startReceiver();
     void receiverLoop();
+    void handleDatagram(std::string_view data);
+    void joinGroup(std::string_view room, std::string_view endpoint);
+    void leaveGroup();
+    void handleFrame(const ReliableFrame& frame);
+    void sendRaw(std::string_view data);
+    void sendData(std::string_view data, bool sequenced);
     void sendMessage(const Message& msg);
+    void sendChat(const std::string& text);
     void joinRoom(const std::string& room);
     void leaveRoom();
 };
@@ -1,33 +1,163 @@
 #ifndef CHAT_SERVER_H
 #define CHAT_SERVER_H
 
-#include <map>
 #include <memory>
-#include <mutex>
+#include <vector>
 #include <string>
 #include <atomic>
 #include <netinet/in.h>
+#include "Federation.h"
+#include "Fragment.h"
+#include "IoEngine.h"
 #include "Room.h"
-#include "Message.h"
+#include "MessageView.h"
+#include "OutboundQueue.h"
+#include "ReliableChannel.h"
+#include "SymbolTable.h"
+#include "TcpTransport.h"
+#include "TimerWheel.h"
+#include "TokenBucket.h"
+#include "UserDirectory.h"
+#include "WorkerGroup.h"
 
-class ChatServer {
+struct ServerOptions {
+    std::size_t history_size = 32;   // datagrams replayed to a user on JOIN
+    int64_t idle_timeout_ms = 15000; // evict users silent for this long, 0 disables
+    int64_t coalesce_ms = 2;         // hold outbound chat this long to coalesce, 0 disables
+    std::size_t mtu = kMaxDatagram;  // largest coalesced datagram payload
+    double recipient_rate = 1 << 20; // bytes/sec sent to one user, 0 = unlimited
+    double recipient_burst = 64 << 10;
+    double user_rate = 20;           // chat datagrams/sec accepted from one user, 0 = unlimited
+    double user_burst = 40;
+    double room_rate = 1000;         // chat datagrams/sec accepted into one room, 0 = unlimited
+    double room_burst = 2000;
+    int tcp_port = -1;               // -1 uses the UDP port number, 0 disables TCP
+    IoBackend io_backend = IoBackend::Sockets;
+    uint32_t multicast_base = 0;     // group of room 0 (host order), next rooms follow; 0 disables
+    int multicast_port = 0;          // 0 uses the UDP port + 1
+    std::vector<sockaddr_in> cluster_nodes;   // peer link endpoints of every instance, empty = standalone
+    uint32_t cluster_index = 0;               // this instance's entry in cluster_nodes
+};
+
+struct Session {
+    sockaddr_in addr{};
+    int tcp_fd{-1};                              // set while attached over TCP
+    std::unique_ptr<ReliableChannel> reliable;   // set once the user opts in
+    std::vector<uint32_t> rooms;                 // IDs of joined rooms
+    int home_worker{-1};                         // worker holding this user's reliable channel
+    int64_t last_seen_ms{0};
+    OutboundQueue outbound;
+    TokenBucket bucket;
+    TokenBucket flood;                           // inbound chat from this user
+    bool flush_listed{false};
+    bool in_flight_listed{false};
+    bool ack_pending{false};
+};
+
+class ChatServer : private TcpHandler, private FederationHandler {
 public:
-    explicit ChatServer(int port);
-    ~ChatServer();
+    explicit ChatServer(int port, const ServerOptions& options = ServerOptions{},
+                        WorkerGroup* group = nullptr, uint32_t worker_index = 0);
+    ~ChatServer() override;
 
+    // Serves until stop(), then prints this worker's counters.
     void run(); 
+    // Safe to call from any thread: only flags run() and wakes it.
     void stop(); 
 
 private:
     int port_{};
+    ServerOptions options_;
+    WorkerGroup* group_{nullptr};                // null when running as the only worker
+    uint32_t worker_index_{0};
+    std::string log_tag_;
     int sockfd_{-1};
-    std::map<std::string, std::shared_ptr<Room>> rooms_;
-    std::mutex rooms_mutex_;
+    int epoll_fd_{-1};
+    int wake_fd_{-1};                            // eventfd that stop() writes
+    std::unique_ptr<IoEngine> io_;
+    std::unique_ptr<TcpTransport> tcp_;
+    std::unique_ptr<Federation> federation_;     // null outside a cluster
+    SymbolTable user_names_;
+    SymbolTable room_names_;
+    std::vector<std::unique_ptr<Room>> rooms_;   // indexed by room ID
+    std::vector<TokenBucket> room_floods_;       // inbound chat per room, indexed by room ID
     std::atomic<bool> running_{true};
+    std::vector<char> send_buffer_;
+    std::vector<Session> sessions_;              // indexed by user ID
+    UserDirectory directory_;                    // endpoints of users in a room
+    std::vector<uint32_t> in_flight_sessions_;   // reliable sessions with unacked frames
+    std::vector<uint32_t> pending_acks_;
+    std::vector<char> ack_buffers_;
+    int64_t now_ms_{0};
+    int64_t last_tick_ms_{0};
+    TimerWheel idle_timers_;                     // keyed by user ID
+    std::vector<uint32_t> flush_list_;           // sessions with queued outbound chat
+    int64_t flush_deadline_ms_{0};
+    uint64_t datagrams_out_{0};
+    uint64_t records_out_{0};
+    uint64_t throttled_{0};
+    uint64_t multicast_out_{0};
+    uint64_t direct_out_{0};
+    uint64_t direct_dropped_{0};
+    uint64_t fragments_in_{0};
+    uint64_t user_flood_dropped_{0};
+    uint64_t room_flood_dropped_{0};
+    uint64_t forwarded_{0};
+    uint64_t mailbox_dropped_{0};
+    uint64_t retransmits_{0};                    // from reliable channels already closed
+    uint64_t abandoned_{0};
+    uint64_t unauthorized_{0};
+    int forwarded_from_{-1};                     // origin worker of the message being handled
+    bool from_peer_{false};                      // handling chat a cluster peer already admitted
+    std::vector<uint8_t> wake_pending_;          // workers with new mail from this one
+
+    [[nodiscard]] Room* findRoom(std::string_view room_name) const;
+    [[nodiscard]] sockaddr_in groupAddress(uint32_t room_id) const;
+    Room& roomFor(std::string_view room_name);
+    Room* ownedRoom(std::string_view room_name);
+    void onRoomJoined(Room& room);
+    void onRoomLeft(Room& room);
+    Session& sessionFor(uint32_t user_id);
+    Session& attachSession(uint32_t user_id, const MessageView& msg,
+                           const sockaddr_in& client_addr, int tcp_fd);
+    void closeChannel(Session& session);
+    [[nodiscard]] uint32_t senderOf(std::string_view username, const sockaddr_in& addr, int tcp_fd) const;
+    void directoryRetain(uint32_t user_id, const sockaddr_in& addr, int tcp_fd);
+    void directoryRefresh(uint32_t user_id, const sockaddr_in& addr, int tcp_fd);
+    void directoryRelease(uint32_t user_id);
+    [[nodiscard]] bool directoryLookup(std::string_view username, Endpoint& out) const;
+
+    void handleDatagram(std::string_view data, const sockaddr_in& client_addr);
+    void dispatch(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd = -1);
+    [[nodiscard]] bool admit(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd);
+    bool routeToOwner(const MessageView& msg, std::string_view datagram, const sockaddr_in& client_addr);
+    void drainMailboxes();
+    void onMail(const MailRecord& record);
+    void wakeWorkers();
+    void deliver(uint32_t user_id, std::string_view datagram);
+    void sendToSession(uint32_t user_id, std::string_view datagram);
+    void transmit(Session& session, std::string_view frame);
+    void flushSession(uint32_t user_id);
+    void flushOutbound();
+    [[nodiscard]] int pollTimeoutMs() const;
+    void flushAcks();
+    void onTick();
+    void reportStats() const;
+    void touch(std::string_view username);
+    void onIdleTimer(uint32_t user_id);
+    void evict(uint32_t user_id, const char* reason);
+
+    void onTcpFrame(int fd, std::string_view payload) override;
+    void onTcpClosed(int fd, uint32_t user_id) override;
+    void onPeerInbound(std::string_view datagram) override;
+    void onPeerRoom(std::string_view room_name, std::string_view datagram) override;
 
-    void handleJoin(const Message& msg, const sockaddr_in& client_addr);
-    void handleChat(const Message& msg, const sockaddr_in& sender_addr);
-    void handleLeave(const Message& msg, const sockaddr_in& client_addr);
+    void handleJoin(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd);
+    void handleChat(const MessageView& msg, const sockaddr_in& sender_addr);
+    void handleLeave(const MessageView& msg, const sockaddr_in& client_addr);
+    void handleDirect(const MessageView& msg, const sockaddr_in& sender_addr, int tcp_fd);
+    void handleFragment(const MessageView& msg);
+    void fanOut(Room& room, std::string_view datagram);
 };
 
 #endif 
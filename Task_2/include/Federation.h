@@ -0,0 +1,103 @@
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+#include "MessageView.h"
+#include "SymbolTable.h"
+
+// Peer link between the chat_server instances of a cluster. Records bound
+// for one peer are packed into a single UDP datagram per loop iteration,
+// each prefixed by its 2-byte big-endian length:
+//   SUB|<room>              the sender has local members in room; refreshed
+//                           every kRefreshMs and forgotten after kSubscriptionTtlMs
+//   UNSUB|<room>            it has none left
+//   IN|<datagram>           client CHAT or FRAG for a room the receiver owns
+//   ROOM|<room>|<datagram>  room traffic from the owner for local members
+constexpr std::size_t kMaxPeerBatch = 16 << 10;
+
+class FederationHandler {
+public:
+    virtual ~FederationHandler() = default;
+    virtual void onPeerInbound(std::string_view datagram) = 0;
+    virtual void onPeerRoom(std::string_view room_name, std::string_view datagram) = 0;
+};
+
+// Every instance is started with the same node list, so all of them build
+// the same consistent-hash ring and agree on the owner of every room.
+class Federation {
+public:
+    static constexpr uint32_t kVirtualNodes = 64;
+    static constexpr int64_t kRefreshMs = 1000;
+    static constexpr int64_t kSubscriptionTtlMs = 3500;
+
+    Federation(const std::vector<sockaddr_in>& nodes, uint32_t self);
+    ~Federation();
+
+    Federation(const Federation&) = delete;
+    Federation& operator=(const Federation&) = delete;
+
+    [[nodiscard]] int fd() const;
+    [[nodiscard]] uint32_t self() const;
+    [[nodiscard]] uint32_t ownerOf(std::string_view room_name) const;
+    [[nodiscard]] bool owns(std::string_view room_name) const;
+
+    // Local membership of a room owned by another instance.
+    void subscribe(std::string_view room_name);
+    void unsubscribe(std::string_view room_name);
+    // True if another instance has members in a room this one owns.
+    [[nodiscard]] bool hasSubscribers(std::string_view room_name) const;
+
+    // Hands a client message to the owner of its room.
+    void forward(std::string_view type, const MessageView& msg);
+    // Sends room traffic to every instance subscribed to the room.
+    void publish(std::string_view room_name, std::string_view datagram, int64_t now_ms);
+
+    void receive(FederationHandler& handler, int64_t now_ms);
+    void onTick(int64_t now_ms);
+    void flush();
+
+    [[nodiscard]] uint64_t batchesOut() const;
+    [[nodiscard]] uint64_t recordsOut() const;
+
+private:
+    struct Peer {
+        sockaddr_in addr{};
+        std::string batch;
+    };
+    struct Subscriber {
+        uint32_t node;
+        int64_t expires_ms;
+    };
+    struct RoomState {
+        bool subscribed{false};                  // we have members, another node owns it
+        std::vector<Subscriber> subscribers;     // we own it, these nodes have members
+    };
+
+    int fd_{-1};
+    uint32_t self_;
+    std::vector<Peer> peers_;
+    std::vector<std::pair<uint32_t, uint32_t>> ring_;   // (point, node), sorted
+    SymbolTable room_names_;
+    std::vector<RoomState> rooms_;                       // indexed by room ID
+    std::vector<uint32_t> subscribed_;                   // room IDs to refresh
+    std::vector<uint32_t> dirty_;                        // peers with a pending batch
+    std::vector<char> receive_buffer_;
+    int64_t last_refresh_ms_{0};
+    uint64_t batches_out_{0};
+    uint64_t records_out_{0};
+
+    RoomState& roomState(std::string_view room_name);
+    // Queues one record made of parts joined by '|'.
+    void append(uint32_t node, std::initializer_list<std::string_view> parts);
+    void sendBatch(uint32_t node);
+    void onRecord(uint32_t node, std::string_view record, FederationHandler& handler, int64_t now_ms);
+};
+
+#endif
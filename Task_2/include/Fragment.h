@@ -0,0 +1,74 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Chat messages that do not fit one datagram travel as fragments:
+//   FRAG|<user>|<room>|<message id>:<offset>:<total>|<bytes>
+// The server relays each fragment to the room as FRAG|<user>||..., and only
+// the receiving clients put the message back together.
+constexpr std::size_t kMaxMessageBytes = 16 << 10;
+constexpr std::size_t kMaxFragmentHeader = 40;   // all but user, room and bytes
+
+struct Fragment {
+    uint32_t message_id{0};
+    uint32_t offset{0};
+    uint32_t total{0};
+    std::string_view chunk;
+
+    // Parses the content field of a FRAG message; returns false if malformed.
+    [[nodiscard]] static bool parse(std::string_view content, Fragment& out);
+
+    // Writes one FRAG datagram into out; returns 0 if it does not fit or a
+    // field contains kRecordSeparator.
+    [[nodiscard]] static std::size_t encode(char* out, std::size_t capacity,
+                                            std::string_view username, std::string_view room_name,
+                                            uint32_t message_id, uint32_t offset, uint32_t total,
+                                            std::string_view chunk);
+};
+
+// Bounded table of partially received messages, keyed by sender and message
+// ID. Fragments may arrive in any order or more than once. A message that is
+// still incomplete after kTimeoutMs is dropped, and so is the oldest one when
+// the table is full.
+class Reassembler {
+public:
+    static constexpr std::size_t kMaxPending = 64;
+    static constexpr int64_t kTimeoutMs = 3000;
+
+    Reassembler();
+
+    // Returns the whole message once its last missing byte arrives, or an
+    // empty view. The view stays valid until the next call.
+    std::string_view add(std::string_view sender, const Fragment& fragment, int64_t now_ms);
+    void expire(int64_t now_ms);
+
+    [[nodiscard]] std::size_t pending() const;
+    [[nodiscard]] uint64_t dropped() const;
+
+private:
+    struct Pending {
+        bool in_use{false};
+        std::string sender;
+        uint32_t message_id{0};
+        uint32_t total{0};
+        uint32_t received{0};
+        int64_t started_ms{0};
+        std::string data;
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;   // received [begin, end), merged
+    };
+
+    std::vector<Pending> slots_;
+    std::string complete_;
+    std::size_t pending_{0};
+    uint64_t dropped_{0};
+
+    Pending& slotFor(std::string_view sender, uint32_t message_id, int64_t now_ms);
+    void release(Pending& slot, bool completed);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Fixed-size ring of encoded datagrams. All slots are allocated up front,
+// so memory is bounded by capacity * slot size and push never allocates.
+class HistoryRing {
+public:
+    HistoryRing(std::size_t capacity, std::size_t slot_size);
+
+    void push(std::string_view datagram);
+    [[nodiscard]] std::size_t size() const;
+
+    // Visits stored datagrams from oldest to newest.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (count_ == 0) {
+            return;
+        }
+        std::size_t first = (head_ + capacity_ - count_) % capacity_;
+        for (std::size_t i = 0; i < count_; ++i) {
+            std::size_t slot = (first + i) % capacity_;
+            fn(std::string_view(storage_.data() + slot * slot_size_, lengths_[slot]));
+        }
+    }
+
+private:
+    std::size_t capacity_;
+    std::size_t slot_size_;
+    std::size_t head_{0};
+    std::size_t count_{0};
+    std::vector<char> storage_;
+    std::vector<std::size_t> lengths_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <netinet/in.h>
+#include "UdpBatch.h"
+
+enum class IoBackend { Sockets, Uring };
+
+// Datagram I/O for one bound UDP socket. The server watches pollFd() for
+// readability, then takes a batch with receive(); the batch stays valid
+// until the next receive(). send() may hold the datagram until flush().
+class IoEngine {
+public:
+    virtual ~IoEngine() = default;
+
+    // Falls back to the sockets backend if io_uring is unavailable.
+    static std::unique_ptr<IoEngine> create(IoBackend backend, int sockfd);
+
+    [[nodiscard]] virtual const char* name() const = 0;
+    [[nodiscard]] virtual int pollFd() const = 0;
+    // True when datagrams were collected that pollFd() will not report.
+    [[nodiscard]] virtual bool ready() const { return false; }
+
+    // Returns the number of datagrams in the batch, or -1 with errno set.
+    virtual int receive() = 0;
+    [[nodiscard]] virtual std::string_view data(std::size_t index) const = 0;
+    [[nodiscard]] virtual const sockaddr_in& source(std::size_t index) const = 0;
+
+    virtual void send(std::string_view datagram, const sockaddr_in& dest) = 0;
+    virtual void flush() = 0;
+
+    [[nodiscard]] uint64_t operations() const { return operations_; }
+    [[nodiscard]] uint64_t syscalls() const { return syscalls_; }
+
+protected:
+    uint64_t operations_{0};
+    uint64_t syscalls_{0};
+};
+
+// recvmmsg/sendmmsg on a plain socket.
+class SocketEngine : public IoEngine {
+public:
+    SocketEngine(int sockfd, std::size_t recv_capacity, std::size_t send_capacity);
+
+    [[nodiscard]] const char* name() const override { return "sockets"; }
+    [[nodiscard]] int pollFd() const override { return sockfd_; }
+
+    int receive() override;
+    [[nodiscard]] std::string_view data(std::size_t index) const override;
+    [[nodiscard]] const sockaddr_in& source(std::size_t index) const override;
+
+    void send(std::string_view datagram, const sockaddr_in& dest) override;
+    void flush() override;
+
+private:
+    int sockfd_;
+    RecvBatch recv_batch_;
+    SendBatch send_batch_;
+};
+
+#endif
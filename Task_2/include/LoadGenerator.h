@@ -0,0 +1,56 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+struct LoadOptions {
+    std::string server_ip = "127.0.0.1";
+    int server_port = 8080;
+    int clients = 1000;        // simulated users
+    int sockets = 4;           // UDP sockets the users are spread over
+    int room_size = 50;        // users per room
+    int rate = 1000;           // CHAT messages per second, all users combined
+    int duration_sec = 10;
+    int drain_ms = 1000;       // wait for in-flight deliveries after sending stops
+};
+
+struct LoadReport {
+    uint64_t sent{0};
+    uint64_t expected{0};      // sent messages times the size of their room
+    uint64_t received{0};
+    double elapsed_sec{0.0};
+    std::vector<int64_t> latencies_ns;
+
+    [[nodiscard]] std::string toJson(const LoadOptions& options) const;
+};
+
+// Simulates many chat users over a few sockets against a running chat_server
+// and measures end-to-end fan-out latency and delivery loss.
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadOptions& options);
+    ~LoadGenerator();
+
+    LoadReport run();
+
+private:
+    LoadOptions options_;
+    sockaddr_in server_addr_{};
+    std::vector<int> sockfds_;
+    std::string run_tag_;
+    std::atomic<bool> receiving_{false};
+
+    [[nodiscard]] std::string userName(int client) const;
+    [[nodiscard]] std::string roomName(int client) const;
+    [[nodiscard]] int roomMembers(int client) const;
+    void sendTo(int client, const std::string& data);
+    void joinAll();
+    void leaveAll();
+    void receiverLoop(int sockfd, uint64_t& received, std::vector<int64_t>& latencies);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <netinet/in.h>
+
+enum class MailKind : uint8_t {
+    Pad,       // fills the end of the ring when a record would wrap
+    Inbound,   // a client datagram for a room the receiver owns
+    Deliver    // a datagram for a user whose endpoint the receiver owns
+};
+
+struct MailRecord {
+    MailKind kind{MailKind::Pad};
+    uint8_t origin{0};           // index of the sending worker
+    sockaddr_in addr{};          // Inbound: client endpoint
+    std::string_view name;       // Deliver: recipient user name
+    std::string_view payload;
+};
+
+// Lock-free single-producer/single-consumer ring of variable-length
+// records. Records are copied in whole, so the producer's buffers can be
+// reused as soon as push() returns. Views handed to drain()'s callback
+// point into the ring and stay valid until the consumer calls release().
+class Mailbox {
+public:
+    // capacity_bytes must be a power of two.
+    explicit Mailbox(std::size_t capacity_bytes);
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    // Producer side. Returns false if the ring is full.
+    bool push(MailKind kind, uint8_t origin, const sockaddr_in& addr,
+              std::string_view name, std::string_view payload);
+
+    // Consumer side. Calls fn(const MailRecord&) for every queued record.
+    template <typename Fn>
+    std::size_t drain(Fn&& fn) {
+        uint64_t head = read_head_;
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        while (head != tail) {
+            const char* at = buffer_.get() + (head & mask_);
+            // A pad record may be shorter than a header: only size and kind
+            // are guaranteed to be there.
+            Header header;
+            std::memcpy(&header, at, kPrefixSize);
+            if (header.kind != MailKind::Pad) {
+                std::memcpy(&header, at, sizeof(header));
+                MailRecord record;
+                record.kind = header.kind;
+                record.origin = header.origin;
+                record.addr = header.addr;
+                record.name = std::string_view(at + sizeof(Header), header.name_length);
+                record.payload = std::string_view(at + sizeof(Header) + header.name_length,
+                                                  header.payload_length);
+                fn(record);
+                ++count;
+            }
+            head += header.size;
+        }
+        read_head_ = head;
+        return count;
+    }
+
+    // Hands the space of every drained record back to the producer.
+    void release() {
+        head_.store(read_head_, std::memory_order_release);
+    }
+
+private:
+    struct Header {
+        uint32_t size;             // whole record, padded to kAlign
+        MailKind kind;
+        uint8_t origin;
+        uint16_t name_length;
+        uint32_t payload_length;
+        sockaddr_in addr;
+    };
+    static constexpr std::size_t kAlign = 8;
+    static constexpr std::size_t kPrefixSize = 8;   // size, kind, origin, name_length
+
+    std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<char[]> buffer_;
+
+    // Producer and consumer indices live on separate cache lines; the
+    // producer rereads head_ only when its cached copy says the ring is full.
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    uint64_t cached_head_{0};
+    alignas(64) std::atomic<uint64_t> head_{0};
+    uint64_t read_head_{0};
+};
+
+#endif
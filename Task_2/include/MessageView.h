@@ -0,0 +1,60 @@
+#ifndef MESSAGE_VIEW_H
+#define MESSAGE_VIEW_H
+
+#include <cstddef>
+#include <string_view>
+
+// Largest UDP payload that fits a 1500-byte Ethernet MTU without IP fragmentation.
+constexpr std::size_t kMaxDatagram = 1472;
+
+// Separates the records the server coalesces into one datagram. No record may
+// contain it: parse() rejects such input and the encoders refuse to write it.
+constexpr char kRecordSeparator = '\n';
+
+enum class MessageType {
+    Unknown,
+    Join,
+    Chat,
+    Leave,
+    Ping,
+    Group,
+    Direct,
+    Fragment
+};
+
+// Non-owning view of a datagram: every field points into the receive buffer,
+// so the buffer must outlive the view.
+class MessageView {
+public:
+    MessageType type{MessageType::Unknown};
+    std::string_view username;
+    std::string_view room_name;
+    std::string_view content;
+
+    // Anything containing kRecordSeparator parses as Unknown.
+    [[nodiscard]] static MessageView parse(std::string_view data);
+
+    // Writes "CHAT|<username>||<content>" into out; returns 0 if it does not
+    // fit or a field contains kRecordSeparator.
+    [[nodiscard]] static std::size_t encodeChat(char* out, std::size_t capacity,
+                                                std::string_view username,
+                                                std::string_view content);
+
+    // Writes "DIRECT|<from>|<to>|<content>" into out; returns 0 if it does not
+    // fit or a field contains kRecordSeparator.
+    [[nodiscard]] static std::size_t encodeDirect(char* out, std::size_t capacity,
+                                                  std::string_view from, std::string_view to,
+                                                  std::string_view content);
+};
+
+// Calls fn for each record of a datagram that may hold several.
+template <typename Fn>
+void forEachRecord(std::string_view datagram, Fn&& fn) {
+    while (!datagram.empty()) {
+        std::size_t end = datagram.find(kRecordSeparator);
+        fn(datagram.substr(0, end));
+        datagram = (end == std::string_view::npos) ? std::string_view{} : datagram.substr(end + 1);
+    }
+}
+
+#endif
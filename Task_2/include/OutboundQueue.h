@@ -0,0 +1,29 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Coalesces encoded records into one datagram, separated by kRecordSeparator,
+// up to a fixed size; forEachRecord() splits them again. Records must not
+// contain the separator. The buffer is allocated on first use and reused
+// afterwards.
+class OutboundQueue {
+public:
+    // Returns false if record does not fit next to what is already queued.
+    bool append(std::string_view record, std::size_t limit);
+
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] std::size_t records() const;
+    [[nodiscard]] std::string_view datagram() const;
+    void clear();
+
+private:
+    std::vector<char> buffer_;
+    std::size_t length_{0};
+    std::size_t records_{0};
+};
+
+#endif
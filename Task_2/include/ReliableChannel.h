@@ -0,0 +1,153 @@
+#ifndef RELIABLE_CHANNEL_H
+#define RELIABLE_CHANNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Wire frames of the optional reliability layer:
+//   R|<seq>|<inner datagram>       reliable data
+//   ACK|<user>|<cum>|<mask hex>    everything <= cum received; bit i of mask
+//                                  means cum + 2 + i was received as well
+//   NACK|<user>|<first>|<count>    seqs [first, first + count) are missing
+// Anything else is a plain datagram and goes straight to MessageView.
+enum class FrameKind {
+    Plain,
+    Data,
+    Ack,
+    Nack
+};
+
+struct ReliableFrame {
+    FrameKind kind{FrameKind::Plain};
+    std::string_view username;
+    uint32_t seq{0};
+    uint64_t value{0};          // ACK mask or NACK count
+    std::string_view inner;
+
+    [[nodiscard]] static ReliableFrame parse(std::string_view datagram);
+
+    [[nodiscard]] static std::size_t encodeAck(char* out, std::size_t capacity,
+                                               std::string_view username,
+                                               uint32_t cum, uint64_t mask);
+    [[nodiscard]] static std::size_t encodeNack(char* out, std::size_t capacity,
+                                                std::string_view username,
+                                                uint32_t first, uint32_t count);
+};
+
+constexpr std::size_t kMaxReliableHeader = 13;   // "R|4294967295|"
+constexpr std::size_t kMaxControlFrame = 64;
+
+// Per-session reliability state: a bounded retransmit window for the
+// outbound direction and a 64-entry duplicate filter for the inbound one.
+//
+// While the window is full, new frames wait in a queue and go out as ACKs
+// open it. Frames are lost only when that queue overflows or a frame runs
+// out of retries; both count as abandoned().
+class ReliableChannel {
+public:
+    static constexpr std::size_t kWindow = 32;
+    static constexpr std::size_t kMaxQueued = 256;
+    static constexpr int64_t kRetransmitMs = 200;
+    static constexpr int kMaxRetries = 5;
+
+    ReliableChannel();
+
+    // False if inner plus the reliable header would exceed kMaxDatagram;
+    // such datagrams can only be sent plain.
+    [[nodiscard]] static bool fits(std::string_view inner);
+
+    // Frames inner with the next sequence number and keeps a copy for
+    // retransmission. Returns the frame to send, or an empty view if the
+    // window is full and inner was queued (or dropped, once kMaxQueued
+    // frames are waiting). inner must fit().
+    std::string_view wrap(std::string_view inner, int64_t now_ms);
+
+    void onAck(uint32_t cum, uint64_t mask);
+
+    // Sends queued frames into the window slots that ACKs have freed.
+    template <typename Fn>
+    void sendQueued(int64_t now_ms, Fn&& send) {
+        while (!queued_.empty() && !slots_[next_seq_ % kWindow].in_use) {
+            send(store(queued_.front(), now_ms));
+            queued_.pop_front();
+        }
+    }
+
+    // Immediately resends the listed frames that are still held.
+    template <typename Fn>
+    void onNack(uint32_t first, uint32_t count, int64_t now_ms, Fn&& resend) {
+        for (uint32_t seq = first; seq - first < count && seq - first < kWindow; ++seq) {
+            Slot& slot = slots_[seq % kWindow];
+            if (slot.in_use && slot.seq == seq) {
+                slot.last_send_ms = now_ms;
+                ++retransmits_;
+                resend(frame(slot));
+            }
+        }
+    }
+
+    // Resends frames whose ACK is overdue; gives up after kMaxRetries.
+    template <typename Fn>
+    void forEachDue(int64_t now_ms, Fn&& resend) {
+        for (Slot& slot : slots_) {
+            if (!slot.in_use || now_ms - slot.last_send_ms < kRetransmitMs) {
+                continue;
+            }
+            if (slot.retries >= kMaxRetries) {
+                release(slot);
+                ++abandoned_;
+                continue;
+            }
+            ++slot.retries;
+            slot.last_send_ms = now_ms;
+            ++retransmits_;
+            resend(frame(slot));
+        }
+        sendQueued(now_ms, resend);
+    }
+
+    // Records an inbound sequence number. Returns false for duplicates.
+    // Sets gap_first/gap_count when the frame reveals newly missing seqs.
+    bool accept(uint32_t seq, uint32_t& gap_first, uint32_t& gap_count);
+
+    [[nodiscard]] std::size_t encodeAck(char* out, std::size_t capacity,
+                                        std::string_view username) const;
+    [[nodiscard]] bool hasInFlight() const;
+    [[nodiscard]] uint64_t retransmits() const;
+    [[nodiscard]] uint64_t abandoned() const;
+    [[nodiscard]] uint64_t duplicates() const;
+
+private:
+    struct Slot {
+        uint32_t seq{0};
+        uint32_t length{0};
+        int64_t last_send_ms{0};
+        int retries{0};
+        bool in_use{false};
+    };
+
+    std::vector<char> storage_;
+    Slot slots_[kWindow];
+    std::size_t in_flight_{0};
+    uint32_t next_seq_{1};
+    std::deque<std::string> queued_;   // waiting for a free window slot
+
+    uint32_t recv_cum_{0};       // all seqs <= recv_cum_ were received
+    uint64_t recv_mask_{0};      // bit i: recv_cum_ + 2 + i was received
+    uint32_t recv_highest_{0};
+
+    uint64_t retransmits_{0};
+    uint64_t abandoned_{0};
+    uint64_t duplicates_{0};
+
+    [[nodiscard]] std::string_view frame(const Slot& slot) const;
+    std::string_view store(std::string_view inner, int64_t now_ms);
+    void release(Slot& slot);
+    void advanceCum();
+};
+
+#endif
@@ -1,36 +1,94 @@
 #ifndef ROOM_H
 #define ROOM_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <mutex>
+#include <netinet/in.h>
+#include "HistoryRing.h"
 
 struct UserInfo {
-    std::string username;
-    std::string ip;
-    int port;
+    uint32_t user_id;
+    sockaddr_in addr;
+    bool multicast;   // receives room traffic through the room's multicast group
 
-    UserInfo(const std::string& user, const std::string& ip_addr, int port_num);
+    UserInfo(uint32_t id, const sockaddr_in& address, bool via_multicast = false);
     
     bool operator==(const UserInfo& other) const;
 };
 
+// Members live in a dense vector for fan-out; index_ is an open-addressing
+// table from user ID to position there, sized to the room rather than to the
+// highest user ID. Add and remove are O(1) on average (remove swaps with the
+// last member).
+//
+// A room belongs to the worker that owns its name and is only touched from
+// that worker's thread, so it takes no locks.
 class Room {
 private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    struct IndexEntry {
+        uint32_t user_id{kNoSlot};   // kNoSlot marks a free entry
+        uint32_t slot{0};
+    };
+
+    uint32_t room_id_;
     std::string room_name_;
     std::vector<UserInfo> members_;
-    std::mutex mtx_;
+    std::vector<IndexEntry> index_;   // power-of-two size, at most half full
+    std::size_t multicast_count_{0};
+    HistoryRing history_;
+
+    [[nodiscard]] std::size_t probe(uint32_t user_id) const;
+    void rebuildIndex(std::size_t capacity);
+    void eraseIndex(std::size_t pos);
 
 public:
-    Room();
-    explicit Room(const std::string& name);
+    Room(uint32_t id, std::string_view name, std::size_t history_size = 0);
 
     ~Room(); 
 
-    void addUser(const std::string& username, const std::string& ip, int port);
-    void removeUser(const std::string& username);
-    [[nodiscard]] std::vector<UserInfo> getMembers(); 
+    // Returns false if the user was already a member; the multicast flag is
+    // updated either way.
+    bool addUser(uint32_t user_id, const sockaddr_in& addr, bool multicast = false);
+    void removeUser(uint32_t user_id);
+    [[nodiscard]] bool hasUser(uint32_t user_id) const;
+    [[nodiscard]] std::size_t memberCount() const;
+    [[nodiscard]] std::vector<UserInfo> getMembers() const;
+    [[nodiscard]] uint32_t getId() const;
     [[nodiscard]] std::string getName() const; 
+
+    void recordMessage(std::string_view datagram);
+
+    // Visits members without copying the member list.
+    template <typename Fn>
+    void forEachMember(Fn&& fn) const {
+        for (const UserInfo& member : members_) {
+            fn(member);
+        }
+    }
+
+    // Visits only members that need their own copy of room traffic. Returns
+    // true if any member listens on the multicast group instead.
+    template <typename Fn>
+    bool forEachUnicastMember(Fn&& fn) const {
+        if (multicast_count_ < members_.size()) {
+            for (const UserInfo& member : members_) {
+                if (!member.multicast) {
+                    fn(member);
+                }
+            }
+        }
+        return multicast_count_ > 0;
+    }
+
+    // Visits recent datagrams, oldest first.
+    template <typename Fn>
+    void forEachRecent(Fn&& fn) const {
+        history_.forEach(fn);
+    }
 };
 
 #endif 
@@ -0,0 +1,36 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Interns names into dense 32-bit IDs, so they can index flat per-ID tables
+// directly. Released IDs are handed out again before new ones, which keeps
+// those tables as large as the most names ever live at once.
+class SymbolTable {
+public:
+    static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+    SymbolTable() = default;
+    ~SymbolTable() = default;
+
+    uint32_t intern(std::string_view name);
+    // The name stops resolving and its ID may be reused by the next intern().
+    void release(uint32_t id);
+    [[nodiscard]] uint32_t find(std::string_view name) const;
+    [[nodiscard]] std::string_view name(uint32_t id) const;
+    // One past the highest ID handed out so far.
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    // deque never relocates its elements, so the map keys stay valid.
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+    std::vector<uint32_t> free_;
+};
+
+#endif
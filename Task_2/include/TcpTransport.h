@@ -0,0 +1,78 @@
+#ifndef TCP_TRANSPORT_H
+#define TCP_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include "BufferPool.h"
+
+// Frames on the TCP listener are a 4-byte big-endian length followed by the
+// same text payload the UDP protocol uses.
+constexpr std::size_t kTcpHeaderSize = 4;
+constexpr std::size_t kMaxTcpFrame = 64 * 1024;
+
+class TcpHandler {
+public:
+    virtual ~TcpHandler() = default;
+    virtual void onTcpFrame(int fd, std::string_view payload) = 0;
+    virtual void onTcpClosed(int fd, uint32_t user_id) = 0;
+};
+
+// Non-blocking TCP listener and connections driven by an edge-triggered
+// epoll set owned by the caller. Connections are indexed by fd.
+class TcpTransport {
+public:
+    static constexpr uint32_t kNoUser = UINT32_MAX;
+
+    TcpTransport(int port, int epoll_fd);
+    ~TcpTransport();
+
+    TcpTransport(const TcpTransport&) = delete;
+    TcpTransport& operator=(const TcpTransport&) = delete;
+
+    [[nodiscard]] int listenFd() const;
+    void acceptAll();
+    void onEvent(int fd, uint32_t events, TcpHandler& handler);
+
+    // Sends one frame with writev, queueing whatever the socket does not take.
+    // Returns false if the frame was dropped because the backlog is full.
+    bool send(int fd, std::string_view payload);
+
+    void bindUser(int fd, uint32_t user_id);
+    [[nodiscard]] const sockaddr_in& peer(int fd) const;
+
+    // Closes connections that failed during this iteration. Closing is
+    // deferred so callers never see a connection vanish mid fan-out.
+    void reapClosed(TcpHandler& handler);
+
+    [[nodiscard]] std::size_t connectionCount() const;
+
+private:
+    struct Connection {
+        bool open{false};
+        bool closing{false};
+        sockaddr_in peer{};
+        uint32_t user_id{kNoUser};
+        char* read_buffer{nullptr};
+        std::size_t read_length{0};
+        char* write_buffer{nullptr};
+        std::size_t write_offset{0};
+        std::size_t write_length{0};
+    };
+
+    int listen_fd_{-1};
+    int epoll_fd_{-1};
+    std::size_t open_count_{0};
+    BufferPool pool_;
+    std::vector<Connection> connections_;
+    std::vector<int> closing_;
+
+    void onReadable(int fd, TcpHandler& handler);
+    void onWritable(int fd);
+    bool queue(Connection& conn, const char* data, std::size_t length);
+    void markClosing(int fd);
+};
+
+#endif
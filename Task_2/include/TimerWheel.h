@@ -0,0 +1,67 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel over dense integer IDs (one timer per ID).
+// Nodes are intrusive doubly-linked lists indexed by ID, so schedule and
+// cancel are O(1) and advancing costs O(1) per tick plus the timers that
+// actually expire or cascade; pending timers are never scanned.
+class TimerWheel {
+public:
+    TimerWheel(int64_t tick_ms, int64_t start_ms);
+
+    // (Re)arms the timer for id; expirations in the past fire on the next tick.
+    void schedule(uint32_t id, int64_t expire_ms);
+    void cancel(uint32_t id);
+    [[nodiscard]] bool pending(uint32_t id) const;
+    [[nodiscard]] std::size_t size() const;
+
+    // Runs every tick up to now_ms and calls on_expire(id) for due timers.
+    // on_expire may schedule the same id again.
+    template <typename Fn>
+    void advance(int64_t now_ms, Fn&& on_expire) {
+        uint64_t target = now_ms <= start_ms_ ? 0 : static_cast<uint64_t>((now_ms - start_ms_) / tick_ms_);
+        while (current_tick_ < target) {
+            ++current_tick_;
+            if ((current_tick_ & kSlotMask) == 0) {
+                cascade(1);
+            }
+            uint32_t& head = heads_[current_tick_ & kSlotMask];
+            while (head != kNil) {
+                uint32_t id = head;
+                unlink(id);
+                on_expire(id);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr int kSlotBits = 6;
+    static constexpr uint64_t kSlots = uint64_t{1} << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr int kLevels = 4;   // 64^4 ticks of range
+
+    struct Node {
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint32_t bucket{kNil};   // index into heads_, kNil when idle
+        uint64_t expire_tick{0};
+    };
+
+    int64_t tick_ms_;
+    int64_t start_ms_;
+    uint64_t current_tick_{0};
+    std::size_t size_{0};
+    std::vector<uint32_t> heads_;
+    std::vector<Node> nodes_;
+
+    void place(uint32_t id);
+    void unlink(uint32_t id);
+    void cascade(int level);
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <cstdint>
+
+// Classic token bucket refilled lazily from a monotonic millisecond clock.
+// A rate of 0 means unlimited.
+class TokenBucket {
+public:
+    TokenBucket() = default;
+    TokenBucket(double rate_per_sec, double burst);
+
+    void configure(double rate_per_sec, double burst);
+
+    // Takes cost tokens if available; returns false (taking nothing) otherwise.
+    bool consume(double cost, int64_t now_ms);
+
+private:
+    double rate_per_ms_{0.0};
+    double burst_{0.0};
+    double tokens_{0.0};
+    int64_t last_refill_ms_{0};
+};
+
+#endif
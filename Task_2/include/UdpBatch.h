@@ -0,0 +1,53 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "MessageView.h"
+
+// Fixed set of receive buffers filled by a single recvmmsg call.
+// Buffers are allocated once, so receiving never touches the heap.
+class RecvBatch {
+public:
+    explicit RecvBatch(std::size_t capacity);
+
+    // Blocks until at least one datagram arrives; returns the count or -1.
+    int receive(int sockfd);
+
+    [[nodiscard]] std::string_view data(std::size_t index) const;
+    [[nodiscard]] const sockaddr_in& source(std::size_t index) const;
+
+private:
+    std::size_t capacity_;
+    std::vector<char> buffers_;
+    std::vector<iovec> iovs_;
+    std::vector<sockaddr_in> addrs_;
+    std::vector<mmsghdr> msgs_;
+};
+
+// Queues datagrams for one sendmmsg call. Only pointers to the payloads are
+// kept, so they must stay valid until flush().
+class SendBatch {
+public:
+    explicit SendBatch(std::size_t capacity);
+
+    // Flushes first when the batch is already full.
+    void add(int sockfd, std::string_view datagram, const sockaddr_in& dest);
+    void flush(int sockfd);
+    [[nodiscard]] std::size_t pending() const;
+    [[nodiscard]] uint64_t calls() const;
+
+private:
+    std::size_t capacity_;
+    std::size_t count_{0};
+    uint64_t calls_{0};
+    std::vector<iovec> iovs_;
+    std::vector<sockaddr_in> addrs_;
+    std::vector<mmsghdr> msgs_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "IoEngine.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+// io_uring engine built on the raw syscalls. One multishot RECVMSG stays
+// armed on the socket and fills buffers from a ring registered with the
+// kernel; sends are queued as SENDMSG entries and submitted together on
+// flush(). The ring fd is what the caller polls.
+//
+// The constructor throws if the kernel lacks provided-buffer rings or
+// multishot RECVMSG (before 6.0), so IoEngine::create() can fall back.
+// When the caller holds every buffer the receive ends with -ENOBUFS; it is
+// re-armed by the receive() that hands the buffers back, and ready() stays
+// true until then so that call is not left waiting on pollFd().
+class UringEngine : public IoEngine {
+public:
+    explicit UringEngine(int sockfd);
+    ~UringEngine() override;
+
+    UringEngine(const UringEngine&) = delete;
+    UringEngine& operator=(const UringEngine&) = delete;
+
+    [[nodiscard]] const char* name() const override { return "io_uring"; }
+    [[nodiscard]] int pollFd() const override { return ring_fd_; }
+    [[nodiscard]] bool ready() const override { return !ready_.empty() || !recv_armed_; }
+
+    int receive() override;
+    [[nodiscard]] std::string_view data(std::size_t index) const override;
+    [[nodiscard]] const sockaddr_in& source(std::size_t index) const override;
+
+    void send(std::string_view datagram, const sockaddr_in& dest) override;
+    void flush() override;
+
+private:
+    struct Received {
+        uint16_t buffer_id;
+        uint32_t length;
+        sockaddr_in source;
+    };
+
+    struct SendSlot {
+        msghdr msg;
+        iovec iov;
+        sockaddr_in dest;
+    };
+
+    int sockfd_;
+    int ring_fd_{-1};
+
+    void* sq_ring_{nullptr};
+    std::size_t sq_ring_size_{0};
+    void* cq_ring_{nullptr};
+    std::size_t cq_ring_size_{0};
+    io_uring_sqe* sqes_{nullptr};
+    std::size_t sqes_size_{0};
+    unsigned* sq_head_{nullptr};
+    unsigned* sq_tail_{nullptr};
+    unsigned* sq_flags_{nullptr};
+    unsigned* sq_array_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned sq_entries_{0};
+    unsigned sq_local_tail_{0};
+    unsigned to_submit_{0};
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+
+    io_uring_buf* buf_ring_{nullptr};
+    uint16_t* buf_ring_tail_{nullptr};
+    std::size_t buf_ring_size_{0};
+    uint16_t buf_tail_{0};
+    std::vector<char> recv_buffers_;
+    msghdr recv_msg_{};
+    bool recv_armed_{false};
+    int recv_error_{0};                 // result that ended the last receive
+    std::vector<Received> ready_;
+    std::vector<Received> batch_;
+
+    std::vector<SendSlot> slots_;
+    std::vector<char> slot_buffers_;
+    std::vector<uint32_t> free_slots_;
+
+    void setupRing();
+    void setupBufferRing();
+    void release();
+    io_uring_sqe* nextSqe();
+    int submit(unsigned wait_for);
+    void reap();
+    void armReceive();
+    void recycle(uint16_t buffer_id);
+    void publishBuffers();
+    [[nodiscard]] const char* bufferAt(uint16_t buffer_id) const;
+};
+
+#endif
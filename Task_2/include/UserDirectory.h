@@ -0,0 +1,64 @@
+#ifndef USER_DIRECTORY_H
+#define USER_DIRECTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+
+struct Endpoint {
+    sockaddr_in addr{};
+    int tcp_fd{-1};   // set while the user is attached over TCP
+};
+
+// Interned user ID -> current endpoint of every user that is in a room.
+// Entries are reference counted by room, so workers that own different
+// rooms can each hold a user without knowing about the others.
+// Writers are serialized by a mutex. Lookups take no lock: entries live in
+// fixed-size chunks that never move once allocated, and each entry carries
+// a sequence counter that readers retry on while a write is in progress.
+class UserDirectory {
+public:
+    UserDirectory();
+    ~UserDirectory();
+
+    UserDirectory(const UserDirectory&) = delete;
+    UserDirectory& operator=(const UserDirectory&) = delete;
+
+    // Adds one room reference and records the endpoint.
+    void retain(uint32_t user_id, const sockaddr_in& addr, int tcp_fd = -1);
+    // Records a new endpoint for a user that is already present.
+    void refresh(uint32_t user_id, const sockaddr_in& addr, int tcp_fd = -1);
+    // Drops one room reference; the entry disappears with the last one, and
+    // then this returns true.
+    bool release(uint32_t user_id);
+    // Returns false if the user has no current endpoint.
+    [[nodiscard]] bool lookup(uint32_t user_id, Endpoint& out) const;
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    static constexpr uint32_t kChunkBits = 10;
+    static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+    static constexpr uint32_t kMaxChunks = 4096;   // 4M users
+
+    struct Entry {
+        std::atomic<uint32_t> seq{0};    // odd while a write is in progress
+        std::atomic<uint32_t> ip{0};
+        std::atomic<uint16_t> port{0};
+        std::atomic<int32_t> tcp_fd{-1};
+        std::atomic<bool> present{false};
+        uint32_t rooms{0};               // guarded by write_mutex_
+    };
+
+    std::unique_ptr<std::atomic<Entry*>[]> chunks_;
+    std::mutex write_mutex_;
+    std::atomic<std::size_t> size_{0};
+
+    Entry* entryFor(uint32_t user_id);
+    Entry* existing(uint32_t user_id) const;
+    void write(Entry& entry, uint32_t ip, uint16_t port, int32_t tcp_fd, bool present);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -11,6 +12,7 @@ public:
 
     [[nodiscard]] static std::vector<std::string> split(const std::string& str, char delimiter); 
     [[nodiscard]] static std::string join(const std::vector<std::string>& vec, char delimiter);
+    [[nodiscard]] static int64_t monotonicMs();
 };
 
 #endif 
@@ -0,0 +1,56 @@
+#ifndef WORKER_GROUP_H
+#define WORKER_GROUP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+#include "Mailbox.h"
+#include "SymbolTable.h"
+#include "UserDirectory.h"
+
+// State shared by the ChatServer workers of one process. Every room has one
+// owner worker, chosen by hashing its name; other workers hand datagrams
+// for it over through a dedicated SPSC mailbox per (sender, receiver) pair
+// and wake the owner through its eventfd. Rooms themselves are never shared.
+//
+// The user directory is the one table all workers read and write: a user
+// may be in rooms owned by several workers, and DIRECT looks recipients up
+// wherever it arrives. Its name -> ID table is guarded by users_mutex_,
+// taken exclusively on JOIN, LEAVE and eviction and shared by lookups, so
+// an ID cannot be released and reused between resolving a name and reading
+// its entry. Chat and fan-out never take it.
+class WorkerGroup {
+public:
+    explicit WorkerGroup(uint32_t workers);
+    ~WorkerGroup();
+
+    WorkerGroup(const WorkerGroup&) = delete;
+    WorkerGroup& operator=(const WorkerGroup&) = delete;
+
+    [[nodiscard]] uint32_t size() const;
+    [[nodiscard]] uint32_t ownerOf(std::string_view room_name) const;
+
+    [[nodiscard]] Mailbox& mailbox(uint32_t from, uint32_t to);
+    [[nodiscard]] int eventFd(uint32_t worker) const;
+    void wake(uint32_t worker);
+
+    // Directory entries by user name, one reference per joined room. The
+    // name's ID is released with the last reference.
+    void retainUser(std::string_view name, const sockaddr_in& addr, int tcp_fd);
+    void refreshUser(std::string_view name, const sockaddr_in& addr, int tcp_fd);
+    void releaseUser(std::string_view name);
+    [[nodiscard]] bool lookupUser(std::string_view name, Endpoint& out) const;
+
+private:
+    uint32_t workers_;
+    std::vector<std::unique_ptr<Mailbox>> mailboxes_;   // [from * workers_ + to]
+    std::vector<int> event_fds_;
+    mutable std::shared_mutex users_mutex_;
+    SymbolTable users_;
+    UserDirectory directory_;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "LoadGenerator.h"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> <server_port>"
+                  << " [--clients N] [--sockets N] [--room-size N] [--rate MSGS_PER_SEC]"
+                  << " [--duration SEC]" << std::endl;
+        return 1;
+    }
+    LoadOptions options;
+    options.server_ip = argv[1];
+    options.server_port = std::atoi(argv[2]);
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        int value = std::atoi(argv[++i]);
+        if (arg == "--clients") {
+            options.clients = value;
+        } else if (arg == "--sockets") {
+            options.sockets = value;
+        } else if (arg == "--room-size") {
+            options.room_size = value;
+        } else if (arg == "--rate") {
+            options.rate = value;
+        } else if (arg == "--duration") {
+            options.duration_sec = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    try {
+        LoadGenerator generator(options);
+        LoadReport report = generator.run();
+        std::cout << report.toJson(options) << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Load generator error: " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,28 +1,135 @@
 #include "ChatServer.h"
+#include <arpa/inet.h>
 #include <iostream>
 #include <cstdlib>
+#include <memory>
 #include <thread>
 #include <string>
+#include <vector>
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <port> [--history N] [--idle-timeout SEC]"
+                  << " [--coalesce-ms MS] [--mtu BYTES] [--recipient-rate BYTES_PER_SEC]"
+                  << " [--user-rate MSGS_PER_SEC] [--room-rate MSGS_PER_SEC]"
+                  << " [--tcp-port PORT] [--io sockets|uring] [--multicast GROUP[:PORT]]"
+                  << " [--workers N] [--cluster INDEX HOST:PORT,HOST:PORT,...]" << std::endl;
         return 1;
     }
     int port = std::atoi(argv[1]);
+    ServerOptions options;
+    uint32_t workers = 1;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--history" && i + 1 < argc) {
+            options.history_size = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            options.idle_timeout_ms = static_cast<int64_t>(std::atoi(argv[++i])) * 1000;
+        } else if (arg == "--coalesce-ms" && i + 1 < argc) {
+            options.coalesce_ms = std::atoi(argv[++i]);
+        } else if (arg == "--mtu" && i + 1 < argc) {
+            options.mtu = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--recipient-rate" && i + 1 < argc) {
+            options.recipient_rate = std::atof(argv[++i]);
+        } else if (arg == "--user-rate" && i + 1 < argc) {
+            options.user_rate = std::atof(argv[++i]);
+            options.user_burst = options.user_rate * 2;
+        } else if (arg == "--room-rate" && i + 1 < argc) {
+            options.room_rate = std::atof(argv[++i]);
+            options.room_burst = options.room_rate * 2;
+        } else if (arg == "--tcp-port" && i + 1 < argc) {
+            options.tcp_port = std::atoi(argv[++i]);
+        } else if (arg == "--io" && i + 1 < argc) {
+            std::string backend = argv[++i];
+            if (backend == "uring") {
+                options.io_backend = IoBackend::Uring;
+            } else if (backend == "sockets") {
+                options.io_backend = IoBackend::Sockets;
+            } else {
+                std::cerr << "Unknown I/O backend: " << backend << std::endl;
+                return 1;
+            }
+        } else if (arg == "--multicast" && i + 1 < argc) {
+            std::string group = argv[++i];
+            std::size_t colon = group.find(':');
+            in_addr address{};
+            if (inet_pton(AF_INET, group.substr(0, colon).c_str(), &address) <= 0 ||
+                !IN_MULTICAST(ntohl(address.s_addr))) {
+                std::cerr << "Invalid multicast group: " << group << std::endl;
+                return 1;
+            }
+            options.multicast_base = ntohl(address.s_addr);
+            if (colon != std::string::npos) {
+                options.multicast_port = std::atoi(group.c_str() + colon + 1);
+            }
+        } else if (arg == "--cluster" && i + 2 < argc) {
+            options.cluster_index = static_cast<uint32_t>(std::atoi(argv[++i]));
+            std::string nodes = argv[++i];
+            std::size_t start = 0;
+            while (start <= nodes.size()) {
+                std::size_t comma = nodes.find(',', start);
+                std::string node = nodes.substr(start, comma - start);
+                std::size_t colon = node.find(':');
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                if (colon == std::string::npos ||
+                    inet_pton(AF_INET, node.substr(0, colon).c_str(), &addr.sin_addr) <= 0) {
+                    std::cerr << "Invalid cluster node: " << node << std::endl;
+                    return 1;
+                }
+                addr.sin_port = htons(static_cast<uint16_t>(std::atoi(node.c_str() + colon + 1)));
+                options.cluster_nodes.push_back(addr);
+                if (comma == std::string::npos) {
+                    break;
+                }
+                start = comma + 1;
+            }
+        } else if (arg == "--workers" && i + 1 < argc) {
+            int count = std::atoi(argv[++i]);
+            if (count < 1 || count > 255) {
+                std::cerr << "Worker count must be between 1 and 255" << std::endl;
+                return 1;
+            }
+            workers = static_cast<uint32_t>(count);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (!options.cluster_nodes.empty() && (workers > 1 || options.multicast_base != 0)) {
+        std::cerr << "--cluster cannot be combined with --workers or --multicast" << std::endl;
+        return 1;
+    }
     try {
-        ChatServer server(port);
-        std::thread control([&server]() {
+        // One worker per thread, each with its own SO_REUSEPORT socket.
+        std::unique_ptr<WorkerGroup> group;
+        if (workers > 1) {
+            group = std::make_unique<WorkerGroup>(workers);
+        }
+        std::vector<std::unique_ptr<ChatServer>> servers;
+        for (uint32_t i = 0; i < workers; ++i) {
+            servers.push_back(std::make_unique<ChatServer>(port, options, group.get(), i));
+        }
+        std::thread control([&servers]() {
             std::string line;
             while (std::getline(std::cin, line)) {
                 if (line == "/quit" || line == "/shutdown") {
-                    server.stop();
+                    for (auto& server : servers) {
+                        server->stop();
+                    }
                     break;
                 }
             }
         });
         control.detach(); // Do not block shutdown if stdin waits
-        server.run();
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < workers; ++i) {
+            threads.emplace_back([&servers, i]() { servers[i]->run(); });
+        }
+        servers[0]->run();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
     } catch (const std::exception& ex) {
         std::cerr << "Server error: " << ex.what() << std::endl;
         return 1;
@@ -0,0 +1,31 @@
+#include "BufferPool.h"
+
+BufferPool::BufferPool(std::size_t chunk_size) : chunk_size_(chunk_size) {}
+
+char* BufferPool::acquire() {
+    if (free_.empty()) {
+        chunks_.push_back(std::make_unique<char[]>(chunk_size_));
+        return chunks_.back().get();
+    }
+    char* chunk = free_.back();
+    free_.pop_back();
+    return chunk;
+}
+
+void BufferPool::release(char* chunk) {
+    if (chunk != nullptr) {
+        free_.push_back(chunk);
+    }
+}
+
+std::size_t BufferPool::chunkSize() const {
+    return chunk_size_;
+}
+
+std::size_t BufferPool::allocated() const {
+    return chunks_.size();
+}
+
+std::size_t BufferPool::available() const {
+    return free_.size();
+}
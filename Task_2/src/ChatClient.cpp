@@ -1,11 +1,21 @@
 #include "ChatClient.h"
+#include "MessageView.h"
+#include "Utils.h"
 #include <arpa/inet.h>
+#include <cerrno>
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-ChatClient::ChatClient(const std::string& serverIp, int serverPort) {
+namespace {
+constexpr int kReceivePollMs = 50;
+constexpr int64_t kHeartbeatIntervalMs = 5000;
+}
+
+ChatClient::ChatClient(const std::string& serverIp, int serverPort, ClientMode mode) {
     sockfd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd_ < 0) {
         throw std::runtime_error("Failed to create socket");
@@ -17,6 +27,13 @@ ChatClient::ChatClient(const std::string& serverIp, int serverPort) {
         ::close(sockfd_);
         throw std::runtime_error("Invalid server IP address");
     }
+    if (mode == ClientMode::Reliable) {
+        reliable_ = std::make_unique<ReliableChannel>();
+    }
+    multicast_ = mode == ClientMode::Multicast;
+    // Receivers key partial messages by sender and ID, so a restarted
+    // client should not reuse the IDs of its previous run.
+    next_message_id_ = static_cast<uint32_t>(Utils::monotonicMs());
 }
 
 ChatClient::~ChatClient() {
@@ -24,6 +41,9 @@ ChatClient::~ChatClient() {
     if (receiver_thread_.joinable()) {
         receiver_thread_.join();
     }
+    if (group_fd_ >= 0) {
+        ::close(group_fd_);
+    }
 }
 
 void ChatClient::startReceiver() {
@@ -31,25 +51,185 @@ void ChatClient::startReceiver() {
 }
 
 void ChatClient::receiverLoop() {
-    char buffer[1024];
+    char buffer[kMaxDatagram];
+    int64_t last_heartbeat_ms = Utils::monotonicMs();
     while (running_) {
-        sockaddr_in from_addr{};
-        socklen_t addr_len = sizeof(from_addr);
-        int recv_len = recvfrom(sockfd_, buffer, sizeof(buffer) - 1, 0,
-                                reinterpret_cast<struct sockaddr*>(&from_addr), &addr_len);
-        if (recv_len < 0) {
+        // The receiver thread also sends heartbeats and retransmissions, so
+        // it wakes up at least every kReceivePollMs.
+        pollfd fds[2] = {{sockfd_, POLLIN, 0}, {group_fd_, POLLIN, 0}};
+        nfds_t count = group_fd_ >= 0 ? 2 : 1;
+        int ready = poll(fds, count, kReceivePollMs);
+        if (ready < 0 && errno != EINTR) {
             if (running_) {
-                std::cerr << "recvfrom error" << std::endl;
+                std::cerr << "poll error" << std::endl;
             }
             break;
         }
-        buffer[recv_len] = '\0';
-        Message msg = Message::deserialize(std::string(buffer));
-        if (msg.type == "CHAT") {
+        if (ready > 0 && (fds[0].revents & POLLNVAL) != 0) {
+            break;  // the socket was closed by stop()
+        }
+
+        for (nfds_t i = 0; ready > 0 && i < count; ++i) {
+            if ((fds[i].revents & POLLIN) == 0) {
+                continue;
+            }
+            ssize_t recv_len = recv(fds[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (recv_len <= 0) {
+                continue;
+            }
+            std::string_view data(buffer, static_cast<std::size_t>(recv_len));
+            if (i == 0) {
+                handleFrame(ReliableFrame::parse(data));
+            } else {
+                handleDatagram(data);  // group traffic is never sequenced
+            }
+        }
+        int64_t now_ms = Utils::monotonicMs();
+        reassembly_.expire(now_ms);
+        if (reliable_) {
+            std::lock_guard<std::mutex> lock(reliable_mutex_);
+            reliable_->forEachDue(now_ms, [this](std::string_view resend) {
+                sendRaw(resend);
+            });
+        }
+        if (now_ms - last_heartbeat_ms >= kHeartbeatIntervalMs) {
+            last_heartbeat_ms = now_ms;
+            std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+            if (!heartbeat_.empty()) {
+                sendRaw(heartbeat_);
+            }
+        }
+    }
+}
+
+void ChatClient::handleFrame(const ReliableFrame& frame) {
+    if (frame.kind == FrameKind::Plain) {
+        handleDatagram(frame.inner);
+        return;
+    }
+    if (!reliable_) {
+        return;
+    }
+
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> lock(reliable_mutex_);
+        char control[kMaxControlFrame];
+        switch (frame.kind) {
+            case FrameKind::Data: {
+                uint32_t gap_first = 0;
+                uint32_t gap_count = 0;
+                fresh = reliable_->accept(frame.seq, gap_first, gap_count);
+                if (gap_count > 0) {
+                    sendRaw(std::string_view(control, ReliableFrame::encodeNack(
+                        control, sizeof(control), username_, gap_first, gap_count)));
+                }
+                sendRaw(std::string_view(control, reliable_->encodeAck(
+                    control, sizeof(control), username_)));
+                break;
+            }
+            case FrameKind::Ack:
+                reliable_->onAck(frame.seq, frame.value);
+                reliable_->sendQueued(Utils::monotonicMs(),
+                                      [this](std::string_view queued) { sendRaw(queued); });
+                break;
+            case FrameKind::Nack:
+                reliable_->onNack(frame.seq, static_cast<uint32_t>(frame.value),
+                                  Utils::monotonicMs(),
+                                  [this](std::string_view resend) { sendRaw(resend); });
+                break;
+            case FrameKind::Plain:
+                break;
+        }
+    }
+    if (fresh) {
+        handleDatagram(frame.inner);
+    }
+}
+
+void ChatClient::handleDatagram(std::string_view data) {
+    // The server may coalesce several messages into one datagram.
+    forEachRecord(data, [this](std::string_view record) {
+        MessageView msg = MessageView::parse(record);
+        if (msg.type == MessageType::Chat) {
             std::cout << "\n[" << msg.username << "]: " << msg.content << std::endl;
             std::cout << "> " << std::flush;
+        } else if (msg.type == MessageType::Direct) {
+            std::cout << "\n[" << msg.username << " -> you]: " << msg.content << std::endl;
+            std::cout << "> " << std::flush;
+        } else if (msg.type == MessageType::Fragment) {
+            Fragment fragment;
+            if (Fragment::parse(msg.content, fragment)) {
+                std::string_view whole = reassembly_.add(msg.username, fragment, Utils::monotonicMs());
+                if (!whole.empty()) {
+                    std::cout << "\n[" << msg.username << "]: " << whole << std::endl;
+                    std::cout << "> " << std::flush;
+                }
+            }
+        } else if (msg.type == MessageType::Group && multicast_) {
+            joinGroup(msg.room_name, msg.content);
+        }
+    });
+}
+
+// Called on the receiver thread when the server answers a multicast JOIN
+// with "GROUP||<room>|<group ip>:<port>".
+void ChatClient::joinGroup(std::string_view room, std::string_view endpoint) {
+    std::lock_guard<std::mutex> lock(group_mutex_);
+    std::size_t colon = endpoint.rfind(':');
+    if (room != group_room_ || colon == std::string_view::npos) {
+        return;
+    }
+    std::string address(endpoint.substr(0, colon));
+    int port = std::atoi(std::string(endpoint.substr(colon + 1)).c_str());
+    ip_mreq group{};
+    if (inet_pton(AF_INET, address.c_str(), &group.imr_multiaddr) <= 0 || port <= 0) {
+        return;
+    }
+    group.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    if (group_fd_ >= 0 && group_port_ != port) {
+        ::close(group_fd_);
+        group_fd_ = -1;
+        in_group_ = false;
+    }
+    if (group_fd_ < 0) {
+        int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            return;
         }
+        // Several clients on one host share the group port, and each should
+        // only see the groups it joined itself.
+        int reuse = 1;
+        int all = 0;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &all, sizeof(all));
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(static_cast<uint16_t>(port));
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+            ::close(fd);
+            std::cerr << "Failed to bind multicast port " << port << std::endl;
+            return;
+        }
+        group_fd_ = fd;
+        group_port_ = port;
+    }
+    if (in_group_) {
+        setsockopt(group_fd_, IPPROTO_IP, IP_DROP_MEMBERSHIP, &group_, sizeof(group_));
+    }
+    in_group_ = setsockopt(group_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) == 0;
+    group_ = group;
+}
+
+void ChatClient::leaveGroup() {
+    std::lock_guard<std::mutex> lock(group_mutex_);
+    if (in_group_) {
+        setsockopt(group_fd_, IPPROTO_IP, IP_DROP_MEMBERSHIP, &group_, sizeof(group_));
+        in_group_ = false;
     }
+    group_room_.clear();
 }
 
 void ChatClient::stop() {
@@ -61,16 +241,74 @@ void ChatClient::stop() {
     }
 }
 
+void ChatClient::sendRaw(std::string_view data) {
+    sendto(sockfd_, data.data(), data.size(), 0,
+           reinterpret_cast<struct sockaddr*>(&server_addr_), sizeof(server_addr_));
+}
+
+void ChatClient::sendData(std::string_view data, bool sequenced) {
+    if (reliable_ && sequenced && ReliableChannel::fits(data)) {
+        std::lock_guard<std::mutex> lock(reliable_mutex_);
+        std::string_view frame = reliable_->wrap(data, Utils::monotonicMs());
+        if (!frame.empty()) {
+            sendRaw(frame);
+        }
+        return;
+    }
+    sendRaw(data);
+}
+
 void ChatClient::sendMessage(const Message& msg) {
+    // Presence traffic (JOIN/LEAVE) stays fire-and-forget.
+    sendData(msg.serialize(), msg.type == "CHAT");
+}
+
+// Chat that does not fit one datagram goes out as FRAG datagrams, which are
+// sequenced like CHAT in reliable mode.
+void ChatClient::sendChat(const std::string& text) {
+    if (text.find(kRecordSeparator) != std::string::npos) {
+        std::cout << "Messages cannot contain line breaks" << std::endl;
+        return;
+    }
+    Message msg("CHAT", username_, current_room_, text);
+    std::size_t limit = kMaxDatagram - (reliable_ ? kMaxReliableHeader : 0);
     std::string data = msg.serialize();
-    sendto(sockfd_, data.c_str(), data.length(), 0,
-           reinterpret_cast<struct sockaddr*>(&server_addr_), sizeof(server_addr_));
+    if (data.size() <= limit) {
+        sendData(data, true);
+        return;
+    }
+    std::size_t overhead = kMaxFragmentHeader + username_.size() + current_room_.size();
+    if (text.size() > kMaxMessageBytes || overhead >= limit) {
+        std::cout << "Message too long (limit " << kMaxMessageBytes << " bytes)" << std::endl;
+        return;
+    }
+
+    std::size_t chunk = limit - overhead;
+    uint32_t message_id = next_message_id_++;
+    uint32_t total = static_cast<uint32_t>(text.size());
+    char datagram[kMaxDatagram];
+    for (std::size_t offset = 0; offset < text.size(); offset += chunk) {
+        std::size_t length = Fragment::encode(datagram, limit, username_, current_room_, message_id,
+                                              static_cast<uint32_t>(offset), total,
+                                              std::string_view(text).substr(offset, chunk));
+        sendData(std::string_view(datagram, length), true);
+    }
 }
 
 void ChatClient::joinRoom(const std::string& room) {
     current_room_ = room;
-    Message msg("JOIN", username_, current_room_);
+    if (multicast_) {
+        leaveGroup();
+        std::lock_guard<std::mutex> lock(group_mutex_);
+        group_room_ = room;
+    }
+    Message msg("JOIN", username_, current_room_,
+                reliable_ ? "reliable" : (multicast_ ? "multicast" : ""));
     sendMessage(msg);
+    {
+        std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+        heartbeat_ = Message("PING", username_, current_room_).serialize();
+    }
     std::cout << "✓ Joined room '" << current_room_ << "'" << std::endl;
 }
 
@@ -81,6 +319,13 @@ void ChatClient::leaveRoom() {
     }
     Message msg("LEAVE", username_, current_room_);
     sendMessage(msg);
+    if (multicast_) {
+        leaveGroup();
+    }
+    {
+        std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+        heartbeat_.clear();
+    }
     std::cout << "✓ Left room '" << current_room_ << "'" << std::endl;
     current_room_.clear();
 }
@@ -98,6 +343,7 @@ void ChatClient::run() {
     std::cout << "\nCommands:\n";
     std::cout << "  /join <room>    - Join a room\n";
     std::cout << "  /leave          - Leave current room\n";
+    std::cout << "  /msg <user> <text> - Send a private message\n";
     std::cout << "  /quit           - Exit application\n\n";
 
     startReceiver();
@@ -115,6 +361,13 @@ void ChatClient::run() {
                 continue;
             }
             joinRoom(input.substr(6));
+        } else if (input.rfind("/msg ", 0) == 0) {
+            std::size_t space = input.find(' ', 5);
+            if (space == std::string::npos || space == 5 || space + 1 >= input.length()) {
+                std::cout << "Usage: /msg <user> <text>" << std::endl;
+                continue;
+            }
+            sendMessage(Message("DIRECT", username_, input.substr(5, space - 5), input.substr(space + 1)));
         } else if (input == "/leave") {
             leaveRoom();
         } else if (input == "/quit") {
@@ -129,8 +382,7 @@ void ChatClient::run() {
                 std::cout << "Join a room first with /join <room>" << std::endl;
                 continue;
             }
-            Message msg("CHAT", username_, current_room_, input);
-            sendMessage(msg);
+            sendChat(input);
         }
     }
 }
@@ -1,16 +1,50 @@
 #include "ChatServer.h"
+#include "Message.h"
+#include "Utils.h"
 #include <arpa/inet.h>
+#include <algorithm>
 #include <iostream>
+#include <cerrno>
 #include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-ChatServer::ChatServer(int port) : port_(port) {
+namespace {
+constexpr std::size_t kMaxAcksPerBatch = 128;  // at least the largest receive batch
+constexpr int64_t kTickMs = 20;
+constexpr int64_t kIdleWheelTickMs = 100;
+constexpr int kMaxEvents = 256;
+
+bool sameEndpoint(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+}
+
+ChatServer::ChatServer(int port, const ServerOptions& options, WorkerGroup* group,
+                       uint32_t worker_index)
+    : port_(port),
+      options_(options),
+      group_(group),
+      worker_index_(worker_index),
+      log_tag_(group ? "[WORKER " + std::to_string(worker_index) + "]" : "[SERVER]"),
+      send_buffer_(kMaxTcpFrame),
+      ack_buffers_(kMaxAcksPerBatch * kMaxControlFrame),
+      idle_timers_(kIdleWheelTickMs, Utils::monotonicMs()) {
     sockfd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd_ < 0) {
         throw std::runtime_error("Failed to create socket");
     }
 
+    if (group_) {
+        // Every worker binds the same port; the kernel spreads clients over
+        // the sockets by address hash, so a client always lands on one worker.
+        int reuse = 1;
+        setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+        wake_pending_.assign(group_->size(), 0);
+    }
+
     sockaddr_in server_addr{};
     std::memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
@@ -22,97 +56,982 @@ ChatServer::ChatServer(int port) : port_(port) {
         throw std::runtime_error("Failed to bind socket");
     }
 
+    if (options_.mtu > kMaxDatagram) {
+        options_.mtu = kMaxDatagram;
+    }
+    if (options_.multicast_base != 0) {
+        if (options_.multicast_port == 0) {
+            options_.multicast_port = port_ + 1;
+        }
+        // Keep group traffic on the local network and loop it back to
+        // members on this host.
+        unsigned char ttl = 1;
+        unsigned char loop = 1;
+        setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ::close(sockfd_);
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    io_ = IoEngine::create(options_.io_backend, sockfd_);
+    // UDP stays level-triggered: run() takes one receive batch per wakeup.
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = io_->pollFd();
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, io_->pollFd(), &ev);
+    if (group_) {
+        ev.data.fd = group_->eventFd(worker_index_);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        ::close(epoll_fd_);
+        ::close(sockfd_);
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    ev.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    // TCP connections are not sharded yet, so workers serve UDP only.
+    int tcp_port = group_ ? 0 : (options_.tcp_port < 0 ? port_ : options_.tcp_port);
+    if (tcp_port > 0) {
+        try {
+            tcp_ = std::make_unique<TcpTransport>(tcp_port, epoll_fd_);
+        } catch (...) {
+            ::close(wake_fd_);
+            ::close(epoll_fd_);
+            ::close(sockfd_);
+            throw;
+        }
+    }
+    if (!options_.cluster_nodes.empty()) {
+        try {
+            federation_ = std::make_unique<Federation>(options_.cluster_nodes, options_.cluster_index);
+        } catch (...) {
+            ::close(wake_fd_);
+            ::close(epoll_fd_);
+            ::close(sockfd_);
+            throw;
+        }
+        ev.data.fd = federation_->fd();
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
+
+    if (worker_index_ != 0) {
+        return;
+    }
     std::cout << "═══════════════════════════════════════\n";
     std::cout << "    UDP CHAT SERVER STARTED\n";
-    std::cout << "    Listening on port " << port_ << "\n";
+    std::cout << "    Listening on port " << port_ << " (" << io_->name() << ")\n";
+    if (group_) {
+        std::cout << "    " << group_->size() << " workers, rooms sharded by name\n";
+    }
+    if (tcp_) {
+        std::cout << "    TCP listener on port " << tcp_port << "\n";
+    }
+    if (federation_) {
+        std::cout << "    Cluster node " << options_.cluster_index << " of "
+                  << options_.cluster_nodes.size() << "\n";
+    }
+    if (options_.multicast_base != 0) {
+        sockaddr_in group = groupAddress(0);
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &group.sin_addr, text, sizeof(text));
+        std::cout << "    Multicast groups from " << text << ":" << options_.multicast_port << "\n";
+    }
     std::cout << "═══════════════════════════════════════\n";
     std::cout << "\n[SERVER] Waiting for users to connect...\n" << std::endl;
 }
 
 ChatServer::~ChatServer() {
+    tcp_.reset();
+    io_.reset();
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
     if (sockfd_ >= 0) {
         ::close(sockfd_);
     }
 }
 
-void ChatServer::handleJoin(const Message& msg, const sockaddr_in& client_addr) {
-    std::lock_guard<std::mutex> lock(rooms_mutex_);
-    std::string ip = inet_ntoa(client_addr.sin_addr);
-    int port = ntohs(client_addr.sin_port);
+Room* ChatServer::findRoom(std::string_view room_name) const {
+    uint32_t room_id = room_names_.find(room_name);
+    if (room_id == SymbolTable::kInvalidId || room_id >= rooms_.size()) {
+        return nullptr;
+    }
+    return rooms_[room_id].get();
+}
+
+sockaddr_in ChatServer::groupAddress(uint32_t room_id) const {
+    sockaddr_in group{};
+    group.sin_family = AF_INET;
+    group.sin_port = htons(static_cast<uint16_t>(options_.multicast_port));
+    // Room IDs are per worker, and every worker owns a disjoint set of rooms.
+    uint32_t workers = group_ ? group_->size() : 1;
+    group.sin_addr.s_addr = htonl(options_.multicast_base + room_id * workers + worker_index_);
+    return group;
+}
+
+Session& ChatServer::sessionFor(uint32_t user_id) {
+    if (user_id >= sessions_.size()) {
+        std::size_t first_new = sessions_.size();
+        sessions_.resize(user_id + 1);
+        for (std::size_t i = first_new; i < sessions_.size(); ++i) {
+            sessions_[i].bucket.configure(options_.recipient_rate, options_.recipient_burst);
+            sessions_[i].flood.configure(options_.user_rate, options_.user_burst);
+        }
+    }
+    return sessions_[user_id];
+}
+
+Session& ChatServer::attachSession(uint32_t user_id, const MessageView& msg,
+                                   const sockaddr_in& client_addr, int tcp_fd) {
+    Session& session = sessionFor(user_id);
+    bool moved = !sameEndpoint(session.addr, client_addr);
+    session.addr = client_addr;
+    session.last_seen_ms = now_ms_;
+    session.tcp_fd = tcp_fd;
+    if (moved && !session.rooms.empty()) {
+        directoryRefresh(user_id, client_addr, tcp_fd);
+    }
+    if (tcp_fd >= 0) {
+        // TCP is already reliable, and a closed connection ends the session.
+        tcp_->bindUser(tcp_fd, user_id);
+        closeChannel(session);
+    } else if (msg.content != "reliable") {
+        closeChannel(session);
+    } else if (!session.reliable || moved) {
+        // A new endpoint means a restarted client with fresh sequence numbers.
+        closeChannel(session);
+        session.reliable = std::make_unique<ReliableChannel>();
+    }
+    return session;
+}
+
+// A session is keyed by (endpoint, username): traffic is accepted under a
+// name only from the endpoint or TCP connection that last joined with it.
+// One socket may carry many users, as chat_loadgen's do.
+uint32_t ChatServer::senderOf(std::string_view username, const sockaddr_in& addr, int tcp_fd) const {
+    uint32_t user_id = user_names_.find(username);
+    if (user_id >= sessions_.size()) {
+        return SymbolTable::kInvalidId;
+    }
+    const Session& session = sessions_[user_id];
+    bool bound = tcp_fd >= 0 ? session.tcp_fd == tcp_fd
+                             : session.tcp_fd < 0 && sameEndpoint(session.addr, addr);
+    return bound ? user_id : SymbolTable::kInvalidId;
+}
+
+// Keeps the channel's loss counters for the shutdown report.
+void ChatServer::closeChannel(Session& session) {
+    if (session.reliable) {
+        retransmits_ += session.reliable->retransmits();
+        abandoned_ += session.reliable->abandoned();
+        session.reliable.reset();
+    }
+}
+
+// With workers, the directory is shared and keyed by name; otherwise it is
+// this server's own, keyed by the local user ID.
+void ChatServer::directoryRetain(uint32_t user_id, const sockaddr_in& addr, int tcp_fd) {
+    if (group_) {
+        group_->retainUser(user_names_.name(user_id), addr, tcp_fd);
+    } else {
+        directory_.retain(user_id, addr, tcp_fd);
+    }
+}
+
+void ChatServer::directoryRefresh(uint32_t user_id, const sockaddr_in& addr, int tcp_fd) {
+    if (group_) {
+        group_->refreshUser(user_names_.name(user_id), addr, tcp_fd);
+    } else {
+        directory_.refresh(user_id, addr, tcp_fd);
+    }
+}
+
+void ChatServer::directoryRelease(uint32_t user_id) {
+    if (group_) {
+        group_->releaseUser(user_names_.name(user_id));
+    } else {
+        directory_.release(user_id);
+    }
+}
+
+bool ChatServer::directoryLookup(std::string_view username, Endpoint& out) const {
+    if (group_) {
+        return group_->lookupUser(username, out);
+    }
+    uint32_t user_id = user_names_.find(username);
+    return user_id != SymbolTable::kInvalidId && directory_.lookup(user_id, out);
+}
+
+Room& ChatServer::roomFor(std::string_view room_name) {
+    uint32_t room_id = room_names_.intern(room_name);
+    if (room_id >= rooms_.size()) {
+        rooms_.resize(room_id + 1);
+        room_floods_.resize(room_id + 1, TokenBucket(options_.room_rate, options_.room_burst));
+    }
+    if (!rooms_[room_id]) {
+        rooms_[room_id] = std::make_unique<Room>(room_id, room_name, options_.history_size);
+    }
+    return *rooms_[room_id];
+}
+
+// Chat only goes to rooms that exist. The one exception is chat relayed by
+// a peer for a room this instance owns but has no members of its own in:
+// the room is created then, but only once the peer has announced members.
+Room* ChatServer::ownedRoom(std::string_view room_name) {
+    Room* room = findRoom(room_name);
+    if (room == nullptr && from_peer_ && federation_->hasSubscribers(room_name)) {
+        room = &roomFor(room_name);
+    }
+    return room;
+}
+
+// In a cluster, an instance that is not the owner of a room keeps a local
+// copy of it for its own members and subscribes to the owner's traffic.
+void ChatServer::onRoomJoined(Room& room) {
+    if (federation_ && room.memberCount() == 1 && !federation_->owns(room.getName())) {
+        federation_->subscribe(room.getName());
+    }
+}
+
+void ChatServer::onRoomLeft(Room& room) {
+    if (federation_ && room.memberCount() == 0 && !federation_->owns(room.getName())) {
+        federation_->unsubscribe(room.getName());
+    }
+}
+
+void ChatServer::handleJoin(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd) {
+    if (msg.username.empty() || msg.room_name.empty()) {
+        return;
+    }
+    // Names are interned only here, so other traffic cannot grow the tables.
+    uint32_t user_id = user_names_.intern(msg.username);
+    Room& room = roomFor(msg.room_name);
+    uint32_t room_id = room.getId();
 
-    if (rooms_.find(msg.room_name) == rooms_.end()) {
-        rooms_[msg.room_name] = std::make_shared<Room>(msg.room_name);
+    Session& session = sessionFor(user_id);
+    bool multicast = options_.multicast_base != 0 && tcp_fd < 0 && msg.content == "multicast";
+    if (forwarded_from_ >= 0 && msg.content == "reliable") {
+        // The worker that receives this client's datagrams keeps its
+        // reliable channel, so deliveries are handed back to it.
+        session.addr = client_addr;
+        session.last_seen_ms = now_ms_;
+        closeChannel(session);
+        session.home_worker = forwarded_from_;
+    } else {
+        attachSession(user_id, msg, client_addr, tcp_fd);
+        session.home_worker = -1;
     }
 
-    rooms_[msg.room_name]->addUser(msg.username, ip, port);
+    if (multicast) {
+        // The server stays the authority on membership: only members learn
+        // the group, and only members may post to the room.
+        sockaddr_in group = groupAddress(room_id);
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &group.sin_addr, text, sizeof(text));
+        std::string endpoint = std::string(text) + ":" + std::to_string(options_.multicast_port);
+        std::string reply = Message("GROUP", "", std::string(msg.room_name), endpoint).serialize();
+        sendto(sockfd_, reply.data(), reply.size(), 0,
+               reinterpret_cast<const struct sockaddr*>(&client_addr), sizeof(client_addr));
+    }
+    if (room.addUser(user_id, client_addr, multicast)) {
+        directoryRetain(user_id, client_addr, tcp_fd);
+        session.rooms.push_back(room_id);
+        onRoomJoined(room);
+        if (options_.idle_timeout_ms > 0 && tcp_fd < 0 && !idle_timers_.pending(user_id)) {
+            idle_timers_.schedule(user_id, now_ms_ + options_.idle_timeout_ms);
+        }
+        room.forEachRecent([this, user_id](std::string_view datagram) {
+            deliver(user_id, datagram);
+        });
+        io_->flush();
+    }
     std::cout << "[" << msg.username << "] joined room '" << msg.room_name << "'" << std::endl;
 }
 
-void ChatServer::handleChat(const Message& msg, const sockaddr_in& sender_addr) {
+void ChatServer::handleChat(const MessageView& msg, const sockaddr_in& sender_addr) {
     (void)sender_addr; 
-    auto it = rooms_.find(msg.room_name);
-    if (it == rooms_.end()) {
+    if (federation_ && !federation_->owns(msg.room_name)) {
+        // The owner orders the room's traffic and sends it back to us.
+        federation_->forward("CHAT", msg);
+        return;
+    }
+    Room* room = ownedRoom(msg.room_name);
+    if (room == nullptr) {
         return;
     }
 
-    std::vector<UserInfo> members = it->second->getMembers();
-    Message outMsg("CHAT", msg.username, "", msg.content);
-    std::string data = outMsg.serialize();
-
-    for (const UserInfo& user : members) {
-        sockaddr_in user_addr{};
-        user_addr.sin_family = AF_INET;
-        user_addr.sin_port = htons(user.port);
-        inet_pton(AF_INET, user.ip.c_str(), &user_addr.sin_addr);
+    std::size_t length = MessageView::encodeChat(send_buffer_.data(), send_buffer_.size(),
+                                                 msg.username, msg.content);
+    if (length == 0) {
+        return;
+    }
 
-        sendto(sockfd_, data.c_str(), data.length(), 0,
-               reinterpret_cast<struct sockaddr*>(&user_addr), sizeof(user_addr));
+    std::string_view datagram(send_buffer_.data(), length);
+    room->recordMessage(datagram);
+    fanOut(*room, datagram);
+    if (federation_) {
+        federation_->publish(msg.room_name, datagram, now_ms_);
     }
 
     std::cout << "[" << msg.room_name << "] " << msg.username << ": " << msg.content << std::endl;
 }
 
-void ChatServer::handleLeave(const Message& msg, const sockaddr_in& client_addr) {
+void ChatServer::fanOut(Room& room, std::string_view datagram) {
+    bool to_group = room.forEachUnicastMember([this, datagram](const UserInfo& user) {
+        deliver(user.user_id, datagram);
+    });
+    if (to_group && datagram.size() <= kMaxDatagram) {
+        // One copy reaches every multicast member, however many there are.
+        ++datagrams_out_;
+        ++multicast_out_;
+        io_->send(datagram, groupAddress(room.getId()));
+    }
+    io_->flush();
+}
+
+// Fragments of a long message are relayed one by one as they arrive; the
+// server never holds a partial message. They are not kept in the history.
+void ChatServer::handleFragment(const MessageView& msg) {
+    if (federation_ && !federation_->owns(msg.room_name)) {
+        federation_->forward("FRAG", msg);
+        return;
+    }
+    Room* room = ownedRoom(msg.room_name);
+    Fragment fragment;
+    if (room == nullptr || !Fragment::parse(msg.content, fragment)) {
+        return;
+    }
+    std::size_t length = Fragment::encode(send_buffer_.data(), send_buffer_.size(), msg.username, "",
+                                          fragment.message_id, fragment.offset, fragment.total,
+                                          fragment.chunk);
+    if (length == 0) {
+        return;
+    }
+    ++fragments_in_;
+    std::string_view datagram(send_buffer_.data(), length);
+    fanOut(*room, datagram);
+    if (federation_) {
+        federation_->publish(msg.room_name, datagram, now_ms_);
+    }
+}
+
+void ChatServer::onPeerInbound(std::string_view datagram) {
+    MessageView msg = MessageView::parse(datagram);
+    if (msg.type == MessageType::Chat || msg.type == MessageType::Fragment) {
+        from_peer_ = true;
+        dispatch(msg, sockaddr_in{});
+        from_peer_ = false;
+    }
+}
+
+void ChatServer::onPeerRoom(std::string_view room_name, std::string_view datagram) {
+    Room* room = findRoom(room_name);
+    if (room == nullptr) {
+        return;
+    }
+    if (MessageView::parse(datagram).type == MessageType::Chat) {
+        room->recordMessage(datagram);
+    }
+    fanOut(*room, datagram);
+}
+
+void ChatServer::handleLeave(const MessageView& msg, const sockaddr_in& client_addr) {
     (void)client_addr; 
-    std::lock_guard<std::mutex> lock(rooms_mutex_);
-    auto it = rooms_.find(msg.room_name);
-    if (it != rooms_.end()) {
-        it->second->removeUser(msg.username);
+    Room* room = findRoom(msg.room_name);
+    uint32_t user_id = user_names_.find(msg.username);
+    if (room != nullptr && user_id != SymbolTable::kInvalidId) {
+        room->removeUser(user_id);
+        onRoomLeft(*room);
+        if (user_id < sessions_.size()) {
+            std::vector<uint32_t>& joined = sessions_[user_id].rooms;
+            for (std::size_t i = 0; i < joined.size(); ++i) {
+                if (joined[i] == room->getId()) {
+                    joined[i] = joined.back();
+                    joined.pop_back();
+                    directoryRelease(user_id);
+                    break;
+                }
+            }
+        }
         std::cout << "[" << msg.username << "] left room '" << msg.room_name << "'" << std::endl;
     }
 }
 
-void ChatServer::run() {
-    while (running_) {
-        char buffer[1024];
-        sockaddr_in client_addr{};
-        socklen_t addr_len = sizeof(client_addr);
-
-        int recv_len = recvfrom(sockfd_, buffer, sizeof(buffer) - 1, 0,
-                                reinterpret_cast<struct sockaddr*>(&client_addr), &addr_len);
-        if (recv_len < 0) {
-            std::cerr << "recvfrom error" << std::endl;
-            continue;
+// DIRECT|<from>|<to>|<text> goes to one user with a single send. Both users
+// must be in a room, and the sender must be talking from its own endpoint.
+void ChatServer::handleDirect(const MessageView& msg, const sockaddr_in& sender_addr, int tcp_fd) {
+    Endpoint sender;
+    Endpoint recipient;
+    if (!directoryLookup(msg.username, sender) || !directoryLookup(msg.room_name, recipient)) {
+        ++direct_dropped_;
+        return;
+    }
+    bool authentic = tcp_fd >= 0 ? sender.tcp_fd == tcp_fd
+                                 : sender.tcp_fd < 0 && sameEndpoint(sender.addr, sender_addr);
+    if (!authentic) {
+        ++direct_dropped_;
+        return;
+    }
+
+    std::size_t length = MessageView::encodeDirect(send_buffer_.data(), send_buffer_.size(),
+                                                   msg.username, msg.room_name, msg.content);
+    if (length == 0) {
+        ++direct_dropped_;
+        return;
+    }
+    std::string_view datagram(send_buffer_.data(), length);
+    if (recipient.tcp_fd >= 0) {
+        if (!tcp_->send(recipient.tcp_fd, datagram)) {
+            ++direct_dropped_;
+            return;
         }
-        buffer[recv_len] = '\0';
+    } else if (length > kMaxDatagram ||
+               sendto(sockfd_, datagram.data(), datagram.size(), 0,
+                      reinterpret_cast<const struct sockaddr*>(&recipient.addr),
+                      sizeof(recipient.addr)) < 0) {
+        ++direct_dropped_;
+        return;
+    }
+    ++direct_out_;
+}
 
-        Message msg = Message::deserialize(std::string(buffer));
-        if (msg.type == "JOIN") {
-            handleJoin(msg, client_addr);
-        } else if (msg.type == "CHAT") {
+void ChatServer::touch(std::string_view username) {
+    uint32_t user_id = user_names_.find(username);
+    if (user_id < sessions_.size()) {
+        sessions_[user_id].last_seen_ms = now_ms_;
+    }
+}
+
+// Heartbeats only refresh last_seen_ms; the timer is re-armed lazily when it
+// fires, so the wheel is touched once per timeout period per user. A user
+// who has left every room stays armed too, so its ID is eventually freed.
+void ChatServer::onIdleTimer(uint32_t user_id) {
+    Session& session = sessions_[user_id];
+    if (session.tcp_fd >= 0) {
+        return;
+    }
+    int64_t deadline = session.last_seen_ms + options_.idle_timeout_ms;
+    if (deadline > now_ms_) {
+        idle_timers_.schedule(user_id, deadline);
+        return;
+    }
+    evict(user_id, "timed out");
+}
+
+void ChatServer::evict(uint32_t user_id, const char* reason) {
+    Session& session = sessions_[user_id];
+    for (uint32_t room_id : session.rooms) {
+        rooms_[room_id]->removeUser(user_id);
+        onRoomLeft(*rooms_[room_id]);
+        directoryRelease(user_id);
+    }
+    std::cout << "[" << user_names_.name(user_id) << "] " << reason << std::endl;
+
+    // The ID goes back to the symbol table for the next new name. Entries on
+    // the flush, in-flight and ack lists stay valid, so their flags carry over.
+    idle_timers_.cancel(user_id);
+    closeChannel(session);
+    Session fresh;
+    fresh.flush_listed = session.flush_listed;
+    fresh.in_flight_listed = session.in_flight_listed;
+    fresh.ack_pending = session.ack_pending;
+    fresh.bucket.configure(options_.recipient_rate, options_.recipient_burst);
+    fresh.flood.configure(options_.user_rate, options_.user_burst);
+    session = std::move(fresh);
+    user_names_.release(user_id);
+}
+
+// Chat is queued per recipient and coalesced into MTU-sized datagrams that
+// flushOutbound() sends once the coalescing deadline passes.
+void ChatServer::deliver(uint32_t user_id, std::string_view datagram) {
+    Session& session = sessions_[user_id];
+    if (session.home_worker >= 0) {
+        // The reliable channel lives on the worker the client talks to.
+        sockaddr_in none{};
+        if (!group_->mailbox(worker_index_, session.home_worker)
+                 .push(MailKind::Deliver, static_cast<uint8_t>(worker_index_), none,
+                       user_names_.name(user_id), datagram)) {
+            ++mailbox_dropped_;
+            return;
+        }
+        wake_pending_[session.home_worker] = 1;
+        return;
+    }
+    ++records_out_;
+    if (session.tcp_fd >= 0) {
+        if (!tcp_->send(session.tcp_fd, datagram)) {
+            ++throttled_;
+        }
+        return;
+    }
+    if (datagram.size() > kMaxDatagram) {
+        // Only TCP members can take messages longer than one datagram.
+        ++throttled_;
+        return;
+    }
+    if (options_.coalesce_ms <= 0) {
+        sendToSession(user_id, datagram);
+        return;
+    }
+
+    std::size_t limit = options_.mtu - (session.reliable ? kMaxReliableHeader : 0);
+    if (!session.outbound.append(datagram, limit)) {
+        flushSession(user_id);
+        // The queue buffer is refilled right away, so it must go out now.
+        io_->flush();
+        if (!session.outbound.append(datagram, limit)) {
+            sendToSession(user_id, datagram);
+            return;
+        }
+    }
+    if (!session.flush_listed) {
+        session.flush_listed = true;
+        if (flush_list_.empty()) {
+            flush_deadline_ms_ = now_ms_ + options_.coalesce_ms;
+        }
+        flush_list_.push_back(user_id);
+    }
+}
+
+void ChatServer::sendToSession(uint32_t user_id, std::string_view datagram) {
+    Session& session = sessions_[user_id];
+    std::string_view frame = datagram;
+    if (session.reliable && ReliableChannel::fits(datagram)) {
+        frame = session.reliable->wrap(datagram, now_ms_);
+        if (!session.in_flight_listed) {
+            session.in_flight_listed = true;
+            in_flight_sessions_.push_back(user_id);
+        }
+        if (frame.empty()) {
+            // Window full: onTick() or the next ACK sends it.
+            return;
+        }
+    }
+    transmit(session, frame);
+}
+
+void ChatServer::transmit(Session& session, std::string_view frame) {
+    if (!session.bucket.consume(static_cast<double>(frame.size()), now_ms_)) {
+        // Reliable frames stay in the window and are retried later.
+        ++throttled_;
+        return;
+    }
+    ++datagrams_out_;
+    io_->send(frame, session.addr);
+}
+
+void ChatServer::flushSession(uint32_t user_id) {
+    OutboundQueue& queue = sessions_[user_id].outbound;
+    if (queue.empty()) {
+        return;
+    }
+    sendToSession(user_id, queue.datagram());
+    queue.clear();
+}
+
+void ChatServer::flushOutbound() {
+    for (uint32_t user_id : flush_list_) {
+        sessions_[user_id].flush_listed = false;
+        flushSession(user_id);
+    }
+    flush_list_.clear();
+    io_->flush();
+}
+
+int ChatServer::pollTimeoutMs() const {
+    if (io_->ready()) {
+        return 0;
+    }
+    int64_t wait = last_tick_ms_ + kTickMs - now_ms_;
+    if (!flush_list_.empty() && flush_deadline_ms_ - now_ms_ < wait) {
+        wait = flush_deadline_ms_ - now_ms_;
+    }
+    return wait < 0 ? 0 : static_cast<int>(wait);
+}
+
+void ChatServer::handleDatagram(std::string_view data, const sockaddr_in& client_addr) {
+    ReliableFrame frame = ReliableFrame::parse(data);
+    switch (frame.kind) {
+        case FrameKind::Plain: {
+            MessageView msg = MessageView::parse(data);
+            if (!routeToOwner(msg, data, client_addr)) {
+                dispatch(msg, client_addr);
+            }
+            break;
+        }
+        case FrameKind::Data: {
+            MessageView msg = MessageView::parse(frame.inner);
+            // Reliable frames carry room traffic, so they must come from the
+            // endpoint whose plain JOIN set up the session; a client that
+            // moves joins again.
+            uint32_t user_id = senderOf(msg.username, client_addr, -1);
+            if (user_id == SymbolTable::kInvalidId) {
+                ++unauthorized_;
+                break;
+            }
+            Session& session = sessions_[user_id];
+            session.last_seen_ms = now_ms_;
+            if (!session.reliable) {
+                session.reliable = std::make_unique<ReliableChannel>();
+            }
+            uint32_t gap_first = 0;
+            uint32_t gap_count = 0;
+            bool fresh = session.reliable->accept(frame.seq, gap_first, gap_count);
+            if (gap_count > 0) {
+                char nack[kMaxControlFrame];
+                std::size_t length = ReliableFrame::encodeNack(nack, sizeof(nack), "",
+                                                               gap_first, gap_count);
+                sendto(sockfd_, nack, length, 0,
+                       reinterpret_cast<const struct sockaddr*>(&client_addr), sizeof(client_addr));
+            }
+            if (!session.ack_pending) {
+                session.ack_pending = true;
+                pending_acks_.push_back(user_id);
+            }
+            if (fresh && !routeToOwner(msg, frame.inner, client_addr)) {
+                dispatch(msg, client_addr);
+            }
+            break;
+        }
+        case FrameKind::Ack:
+        case FrameKind::Nack: {
+            // Like data frames, ACKs and NACKs count only from the session's
+            // own endpoint, so nobody else can free or replay its window.
+            uint32_t user_id = senderOf(frame.username, client_addr, -1);
+            if (user_id == SymbolTable::kInvalidId) {
+                ++unauthorized_;
+                break;
+            }
+            if (!sessions_[user_id].reliable) {
+                break;
+            }
+            Session& session = sessions_[user_id];
+            session.last_seen_ms = now_ms_;
+            if (frame.kind == FrameKind::Ack) {
+                session.reliable->onAck(frame.seq, frame.value);
+                session.reliable->sendQueued(now_ms_, [this, &session](std::string_view queued) {
+                    transmit(session, queued);
+                });
+            } else {
+                session.reliable->onNack(frame.seq, static_cast<uint32_t>(frame.value), now_ms_,
+                    [this, &session](std::string_view resend) {
+                        transmit(session, resend);
+                    });
+            }
+            break;
+        }
+    }
+}
+
+// Room traffic is handled by the worker that owns the room. Datagrams that
+// arrive elsewhere are copied into the owner's mailbox; returns true if so.
+bool ChatServer::routeToOwner(const MessageView& msg, std::string_view datagram,
+                              const sockaddr_in& client_addr) {
+    if (!group_ || (msg.type != MessageType::Join && msg.type != MessageType::Chat &&
+                    msg.type != MessageType::Fragment && msg.type != MessageType::Leave &&
+                    msg.type != MessageType::Ping)) {
+        return false;
+    }
+    uint32_t owner = group_->ownerOf(msg.room_name);
+    if (owner == worker_index_) {
+        return false;
+    }
+    if (msg.type == MessageType::Join && !msg.username.empty() && !msg.room_name.empty()) {
+        // This worker keeps the endpoint and reliable channel, so it also
+        // expires the session when the client goes quiet.
+        uint32_t user_id = user_names_.intern(msg.username);
+        attachSession(user_id, msg, client_addr, -1);
+        if (options_.idle_timeout_ms > 0 && !idle_timers_.pending(user_id)) {
+            idle_timers_.schedule(user_id, now_ms_ + options_.idle_timeout_ms);
+        }
+    } else {
+        // The owner sees the traffic, but this worker's timer needs it too.
+        touch(msg.username);
+    }
+    if (!group_->mailbox(worker_index_, owner)
+             .push(MailKind::Inbound, static_cast<uint8_t>(worker_index_), client_addr, "", datagram)) {
+        ++mailbox_dropped_;
+        return true;
+    }
+    wake_pending_[owner] = 1;
+    ++forwarded_;
+    return true;
+}
+
+void ChatServer::onMail(const MailRecord& record) {
+    if (record.kind == MailKind::Inbound) {
+        forwarded_from_ = record.origin;
+        dispatch(MessageView::parse(record.payload), record.addr);
+        forwarded_from_ = -1;
+        return;
+    }
+    uint32_t user_id = user_names_.find(record.name);
+    if (user_id < sessions_.size() && sessions_[user_id].home_worker < 0) {
+        deliver(user_id, record.payload);
+    }
+}
+
+// Payloads stay in the rings until the sends that point into them are out.
+void ChatServer::drainMailboxes() {
+    for (uint32_t from = 0; from < group_->size(); ++from) {
+        if (from != worker_index_) {
+            group_->mailbox(from, worker_index_).drain([this](const MailRecord& record) {
+                onMail(record);
+            });
+        }
+    }
+    io_->flush();
+    for (uint32_t from = 0; from < group_->size(); ++from) {
+        if (from != worker_index_) {
+            group_->mailbox(from, worker_index_).release();
+        }
+    }
+}
+
+void ChatServer::wakeWorkers() {
+    for (uint32_t worker = 0; worker < wake_pending_.size(); ++worker) {
+        if (wake_pending_[worker]) {
+            wake_pending_[worker] = 0;
+            group_->wake(worker);
+        }
+    }
+}
+
+void ChatServer::onTcpFrame(int fd, std::string_view payload) {
+    dispatch(MessageView::parse(payload), tcp_->peer(fd), fd);
+}
+
+void ChatServer::onTcpClosed(int fd, uint32_t user_id) {
+    if (user_id < sessions_.size() && sessions_[user_id].tcp_fd == fd) {
+        sessions_[user_id].tcp_fd = -1;
+        evict(user_id, "disconnected");
+    }
+}
+
+// Flood control runs before any fan-out work. CHAT, FRAG, DIRECT and LEAVE
+// must come from the session that joined under the sender's name, from the
+// same endpoint or TCP connection (see senderOf()), and room traffic from a
+// member of the room. Each such datagram except LEAVE costs one token from
+// that session's bucket, and room traffic one from the room's as well.
+// Buckets belong to the worker handling the message; chat relayed by a
+// cluster peer was checked against the sender's session there.
+bool ChatServer::admit(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd) {
+    if (msg.type != MessageType::Chat && msg.type != MessageType::Fragment &&
+        msg.type != MessageType::Direct && msg.type != MessageType::Leave) {
+        return true;
+    }
+    if (!from_peer_) {
+        uint32_t user_id = senderOf(msg.username, client_addr, tcp_fd);
+        if (user_id == SymbolTable::kInvalidId) {
+            ++unauthorized_;
+            return false;
+        }
+        if (msg.type == MessageType::Leave) {
+            return true;
+        }
+        Session& session = sessions_[user_id];
+        if (msg.type != MessageType::Direct) {
+            uint32_t room_id = room_names_.find(msg.room_name);
+            if (std::find(session.rooms.begin(), session.rooms.end(), room_id) == session.rooms.end()) {
+                ++unauthorized_;
+                return false;
+            }
+        }
+        if (!session.flood.consume(1.0, now_ms_)) {
+            ++user_flood_dropped_;
+            return false;
+        }
+    }
+    if (msg.type == MessageType::Direct) {
+        return true;
+    }
+    uint32_t room_id = room_names_.find(msg.room_name);
+    if (room_id < room_floods_.size() && !room_floods_[room_id].consume(1.0, now_ms_)) {
+        ++room_flood_dropped_;
+        return false;
+    }
+    return true;
+}
+
+void ChatServer::dispatch(const MessageView& msg, const sockaddr_in& client_addr, int tcp_fd) {
+    if (!admit(msg, client_addr, tcp_fd)) {
+        return;
+    }
+    touch(msg.username);
+    switch (msg.type) {
+        case MessageType::Join:
+            handleJoin(msg, client_addr, tcp_fd);
+            break;
+        case MessageType::Chat:
             handleChat(msg, client_addr);
-        } else if (msg.type == "LEAVE") {
+            break;
+        case MessageType::Leave:
             handleLeave(msg, client_addr);
+            break;
+        case MessageType::Direct:
+            handleDirect(msg, client_addr, tcp_fd);
+            break;
+        case MessageType::Fragment:
+            handleFragment(msg);
+            break;
+        case MessageType::Ping:
+        case MessageType::Group:
+        case MessageType::Unknown:
+            break;
+    }
+}
+
+void ChatServer::flushAcks() {
+    for (std::size_t i = 0; i < pending_acks_.size(); ++i) {
+        Session& session = sessions_[pending_acks_[i]];
+        session.ack_pending = false;
+        if (!session.reliable) {
+            continue;
         }
+        char* buffer = ack_buffers_.data() + i * kMaxControlFrame;
+        std::size_t length = session.reliable->encodeAck(buffer, kMaxControlFrame, "");
+        io_->send(std::string_view(buffer, length), session.addr);
     }
+    io_->flush();
+    pending_acks_.clear();
 }
 
+void ChatServer::onTick() {
+    last_tick_ms_ = now_ms_;
+    for (std::size_t i = 0; i < in_flight_sessions_.size();) {
+        Session& session = sessions_[in_flight_sessions_[i]];
+        if (session.reliable) {
+            session.reliable->forEachDue(now_ms_, [this, &session](std::string_view resend) {
+                transmit(session, resend);
+            });
+        }
+        if (!session.reliable || !session.reliable->hasInFlight()) {
+            session.in_flight_listed = false;
+            in_flight_sessions_[i] = in_flight_sessions_.back();
+            in_flight_sessions_.pop_back();
+            continue;
+        }
+        ++i;
+    }
+    io_->flush();
+
+    idle_timers_.advance(now_ms_, [this](uint32_t user_id) { onIdleTimer(user_id); });
+    if (federation_) {
+        federation_->onTick(now_ms_);
+    }
+}
+
+void ChatServer::run() {
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int ready = epoll_wait(epoll_fd_, events, kMaxEvents, pollTimeoutMs());
+        now_ms_ = Utils::monotonicMs();
+        if (ready < 0 && errno != EINTR && running_) {
+            std::cerr << "epoll_wait error" << std::endl;
+        }
+
+        bool udp_readable = io_->ready();
+        bool mail = false;
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == io_->pollFd()) {
+                udp_readable = true;
+            } else if (fd == wake_fd_) {
+                uint64_t value;
+                ssize_t got = ::read(fd, &value, sizeof(value));
+                (void)got;
+            } else if (group_ && fd == group_->eventFd(worker_index_)) {
+                uint64_t value;
+                ssize_t got = ::read(fd, &value, sizeof(value));
+                (void)got;
+                mail = true;
+            } else if (federation_ && fd == federation_->fd()) {
+                federation_->receive(*this, now_ms_);
+            } else if (tcp_ && fd == tcp_->listenFd()) {
+                tcp_->acceptAll();
+            } else if (tcp_) {
+                tcp_->onEvent(fd, events[i].events, *this);
+            }
+        }
+
+        int count = udp_readable ? io_->receive() : 0;
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && running_) {
+                std::cerr << "receive error" << std::endl;
+            }
+            count = 0;
+        }
+        for (int i = 0; i < count; ++i) {
+            handleDatagram(io_->data(i), io_->source(i));
+        }
+        if (mail) {
+            drainMailboxes();
+        }
+        flushAcks();
+        if (tcp_) {
+            tcp_->reapClosed(*this);
+        }
+
+        if (!flush_list_.empty() && now_ms_ >= flush_deadline_ms_) {
+            flushOutbound();
+        }
+        if (now_ms_ - last_tick_ms_ >= kTickMs) {
+            onTick();
+        }
+        wakeWorkers();
+        if (federation_) {
+            federation_->flush();
+        }
+    }
+    reportStats();
+}
+
+// The counters belong to run()'s thread, so only it reads them.
 void ChatServer::stop() {
-    if (!running_) return;
-    running_ = false;
-    if (sockfd_ >= 0) {
-        ::close(sockfd_); 
-        sockfd_ = -1;
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void ChatServer::reportStats() const {
+    std::cout << log_tag_ << " Shutdown initiated. Sent " << datagrams_out_ << " datagrams for "
+              << records_out_ << " chat deliveries, " << throttled_
+              << " dropped by recipient rate limit, " << multicast_out_
+              << " sent to multicast groups, " << direct_out_ << " direct messages ("
+              << direct_dropped_ << " undeliverable), " << fragments_in_
+              << " message fragments relayed." << std::endl;
+    uint64_t retransmits = retransmits_;
+    uint64_t abandoned = abandoned_;
+    for (const Session& session : sessions_) {
+        if (session.reliable) {
+            retransmits += session.reliable->retransmits();
+            abandoned += session.reliable->abandoned();
+        }
+    }
+    std::cout << log_tag_ << " Reliable delivery: " << retransmits << " retransmits, " << abandoned
+              << " frames abandoned after retries or on a full send queue." << std::endl;
+    std::cout << log_tag_ << " Flood control dropped " << user_flood_dropped_
+              << " datagrams over the per-user limit and " << room_flood_dropped_
+              << " over the per-room limit; " << unauthorized_
+              << " came from senders without a session or room membership." << std::endl;
+    if (federation_) {
+        std::cout << log_tag_ << " Cluster link: " << federation_->recordsOut() << " records in "
+                  << federation_->batchesOut() << " batches." << std::endl;
+    }
+    if (group_) {
+        std::cout << log_tag_ << " Forwarded " << forwarded_ << " datagrams to room owners, "
+                  << mailbox_dropped_ << " dropped on full mailboxes." << std::endl;
     }
-    std::cout << "[SERVER] Shutdown initiated." << std::endl;
+    std::cout << log_tag_ << " " << io_->name() << ": " << io_->operations() << " datagram operations in "
+              << io_->syscalls() << " syscalls." << std::endl;
 }
@@ -0,0 +1,286 @@
+#include "Federation.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// FNV-1a followed by a 32-bit finalizer, so short, similar names still land
+// far apart on the ring.
+uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+std::string nodeName(const sockaddr_in& addr) {
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(ntohs(addr.sin_port));
+}
+
+bool sameEndpoint(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+std::string_view nextField(std::string_view& rest) {
+    std::size_t pos = rest.find('|');
+    std::string_view field = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return field;
+}
+
+} // namespace
+
+Federation::Federation(const std::vector<sockaddr_in>& nodes, uint32_t self)
+    : self_(self), receive_buffer_(kMaxPeerBatch) {
+    if (self_ >= nodes.size()) {
+        throw std::runtime_error("Cluster index out of range");
+    }
+    fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to create peer socket");
+    }
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = nodes[self_].sin_port;
+    local.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        ::close(fd_);
+        throw std::runtime_error("Failed to bind peer port");
+    }
+
+    for (uint32_t node = 0; node < nodes.size(); ++node) {
+        peers_.push_back(Peer{nodes[node], {}});
+        std::string name = nodeName(nodes[node]);
+        for (uint32_t v = 0; v < kVirtualNodes; ++v) {
+            ring_.emplace_back(hashName(name + "#" + std::to_string(v)), node);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+Federation::~Federation() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+int Federation::fd() const {
+    return fd_;
+}
+
+uint32_t Federation::self() const {
+    return self_;
+}
+
+// The owner is the first ring point at or after the room's hash. Adding a
+// node moves only the rooms that fall between its points and their
+// predecessors.
+uint32_t Federation::ownerOf(std::string_view room_name) const {
+    uint32_t hash = hashName(room_name);
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, 0u));
+    return it == ring_.end() ? ring_.front().second : it->second;
+}
+
+bool Federation::owns(std::string_view room_name) const {
+    return ownerOf(room_name) == self_;
+}
+
+bool Federation::hasSubscribers(std::string_view room_name) const {
+    uint32_t room_id = room_names_.find(room_name);
+    return room_id < rooms_.size() && !rooms_[room_id].subscribers.empty();
+}
+
+Federation::RoomState& Federation::roomState(std::string_view room_name) {
+    uint32_t room_id = room_names_.intern(room_name);
+    if (room_id >= rooms_.size()) {
+        rooms_.resize(room_id + 1);
+    }
+    return rooms_[room_id];
+}
+
+void Federation::subscribe(std::string_view room_name) {
+    RoomState& state = roomState(room_name);
+    if (!state.subscribed) {
+        state.subscribed = true;
+        subscribed_.push_back(room_names_.find(room_name));
+    }
+    append(ownerOf(room_name), {"SUB", room_name});
+}
+
+void Federation::unsubscribe(std::string_view room_name) {
+    uint32_t room_id = room_names_.find(room_name);
+    if (room_id == SymbolTable::kInvalidId || !rooms_[room_id].subscribed) {
+        return;
+    }
+    rooms_[room_id].subscribed = false;
+    auto it = std::find(subscribed_.begin(), subscribed_.end(), room_id);
+    *it = subscribed_.back();
+    subscribed_.pop_back();
+    append(ownerOf(room_name), {"UNSUB", room_name});
+}
+
+void Federation::forward(std::string_view type, const MessageView& msg) {
+    append(ownerOf(msg.room_name), {"IN", type, msg.username, msg.room_name, msg.content});
+}
+
+void Federation::publish(std::string_view room_name, std::string_view datagram, int64_t now_ms) {
+    uint32_t room_id = room_names_.find(room_name);
+    if (room_id == SymbolTable::kInvalidId) {
+        return;
+    }
+    std::vector<Subscriber>& subscribers = rooms_[room_id].subscribers;
+    for (std::size_t i = 0; i < subscribers.size();) {
+        if (subscribers[i].expires_ms <= now_ms) {
+            // The node stopped refreshing: it left or went away.
+            subscribers[i] = subscribers.back();
+            subscribers.pop_back();
+            continue;
+        }
+        append(subscribers[i].node, {"ROOM", room_name, datagram});
+        ++i;
+    }
+}
+
+void Federation::append(uint32_t node, std::initializer_list<std::string_view> parts) {
+    std::size_t length = parts.size() - 1;
+    for (std::string_view part : parts) {
+        length += part.size();
+    }
+    if (length > UINT16_MAX || length + 2 > kMaxPeerBatch) {
+        return;
+    }
+    Peer& peer = peers_[node];
+    if (peer.batch.size() + length + 2 > kMaxPeerBatch) {
+        sendBatch(node);
+    }
+    if (peer.batch.empty()) {
+        dirty_.push_back(node);
+    }
+    peer.batch.push_back(static_cast<char>(length >> 8));
+    peer.batch.push_back(static_cast<char>(length & 0xFF));
+    bool first = true;
+    for (std::string_view part : parts) {
+        if (!first) {
+            peer.batch.push_back('|');
+        }
+        peer.batch.append(part);
+        first = false;
+    }
+    ++records_out_;
+}
+
+void Federation::sendBatch(uint32_t node) {
+    Peer& peer = peers_[node];
+    if (peer.batch.empty()) {
+        return;
+    }
+    sendto(fd_, peer.batch.data(), peer.batch.size(), 0,
+           reinterpret_cast<const struct sockaddr*>(&peer.addr), sizeof(peer.addr));
+    ++batches_out_;
+    peer.batch.clear();
+}
+
+void Federation::flush() {
+    for (uint32_t node : dirty_) {
+        sendBatch(node);
+    }
+    dirty_.clear();
+}
+
+void Federation::receive(FederationHandler& handler, int64_t now_ms) {
+    while (true) {
+        sockaddr_in from{};
+        socklen_t from_len = sizeof(from);
+        ssize_t received = recvfrom(fd_, receive_buffer_.data(), receive_buffer_.size(), 0,
+                                    reinterpret_cast<struct sockaddr*>(&from), &from_len);
+        if (received < 0) {
+            return;  // EAGAIN: the socket is drained
+        }
+        uint32_t node = 0;
+        while (node < peers_.size() && !sameEndpoint(peers_[node].addr, from)) {
+            ++node;
+        }
+        if (node == peers_.size() || node == self_) {
+            continue;  // not a cluster member
+        }
+
+        std::string_view batch(receive_buffer_.data(), static_cast<std::size_t>(received));
+        while (batch.size() >= 2) {
+            std::size_t length = (static_cast<unsigned char>(batch[0]) << 8) |
+                                 static_cast<unsigned char>(batch[1]);
+            if (length + 2 > batch.size()) {
+                break;
+            }
+            onRecord(node, batch.substr(2, length), handler, now_ms);
+            batch.remove_prefix(length + 2);
+        }
+    }
+}
+
+void Federation::onRecord(uint32_t node, std::string_view record, FederationHandler& handler,
+                          int64_t now_ms) {
+    std::string_view rest = record;
+    std::string_view tag = nextField(rest);
+    if (tag == "IN") {
+        handler.onPeerInbound(rest);
+    } else if (tag == "ROOM") {
+        std::string_view room_name = nextField(rest);
+        handler.onPeerRoom(room_name, rest);
+    } else if (tag == "SUB" && owns(rest)) {
+        std::vector<Subscriber>& subscribers = roomState(rest).subscribers;
+        int64_t expires_ms = now_ms + kSubscriptionTtlMs;
+        for (Subscriber& subscriber : subscribers) {
+            if (subscriber.node == node) {
+                subscriber.expires_ms = expires_ms;
+                return;
+            }
+        }
+        subscribers.push_back(Subscriber{node, expires_ms});
+    } else if (tag == "UNSUB") {
+        uint32_t room_id = room_names_.find(rest);
+        if (room_id == SymbolTable::kInvalidId) {
+            return;
+        }
+        std::vector<Subscriber>& subscribers = rooms_[room_id].subscribers;
+        for (std::size_t i = 0; i < subscribers.size(); ++i) {
+            if (subscribers[i].node == node) {
+                subscribers[i] = subscribers.back();
+                subscribers.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+// Subscriptions are soft state: the periodic refresh recovers from lost
+// SUB records and from an owner that restarted.
+void Federation::onTick(int64_t now_ms) {
+    if (now_ms - last_refresh_ms_ < kRefreshMs) {
+        return;
+    }
+    last_refresh_ms_ = now_ms;
+    for (uint32_t room_id : subscribed_) {
+        std::string_view room_name = room_names_.name(room_id);
+        append(ownerOf(room_name), {"SUB", room_name});
+    }
+}
+
+uint64_t Federation::batchesOut() const {
+    return batches_out_;
+}
+
+uint64_t Federation::recordsOut() const {
+    return records_out_;
+}
@@ -0,0 +1,172 @@
+#include "Fragment.h"
+#include "MessageView.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+bool parseNumber(std::string_view text, uint32_t& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+}
+
+std::string_view nextField(std::string_view& rest, char separator) {
+    std::size_t pos = rest.find(separator);
+    std::string_view field = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return field;
+}
+
+} // namespace
+
+bool Fragment::parse(std::string_view content, Fragment& out) {
+    std::size_t bar = content.find('|');
+    if (bar == std::string_view::npos) {
+        return false;
+    }
+    std::string_view header = content.substr(0, bar);
+    out.chunk = content.substr(bar + 1);
+    return parseNumber(nextField(header, ':'), out.message_id) &&
+           parseNumber(nextField(header, ':'), out.offset) &&
+           parseNumber(header, out.total) &&
+           out.total <= kMaxMessageBytes && !out.chunk.empty() &&
+           out.offset < out.total && out.chunk.size() <= out.total - out.offset;
+}
+
+std::size_t Fragment::encode(char* out, std::size_t capacity,
+                             std::string_view username, std::string_view room_name,
+                             uint32_t message_id, uint32_t offset, uint32_t total,
+                             std::string_view chunk) {
+    char numbers[34];
+    char* cursor = numbers;
+    char* end = numbers + sizeof(numbers);
+    cursor = std::to_chars(cursor, end, message_id).ptr;
+    *cursor++ = ':';
+    cursor = std::to_chars(cursor, end, offset).ptr;
+    *cursor++ = ':';
+    cursor = std::to_chars(cursor, end, total).ptr;
+    std::string_view header(numbers, static_cast<std::size_t>(cursor - numbers));
+
+    constexpr std::string_view prefix = "FRAG|";
+    std::size_t length = prefix.size() + username.size() + 1 + room_name.size() + 1 +
+                         header.size() + 1 + chunk.size();
+    for (std::string_view field : {username, room_name, chunk}) {
+        if (field.find(kRecordSeparator) != std::string_view::npos) {
+            return 0;
+        }
+    }
+    if (length > capacity) {
+        return 0;
+    }
+    char* at = out;
+    for (std::string_view part : {prefix, username, std::string_view("|"), room_name,
+                                  std::string_view("|"), header, std::string_view("|"), chunk}) {
+        std::memcpy(at, part.data(), part.size());
+        at += part.size();
+    }
+    return length;
+}
+
+Reassembler::Reassembler() : slots_(kMaxPending) {}
+
+Reassembler::Pending& Reassembler::slotFor(std::string_view sender, uint32_t message_id,
+                                           int64_t now_ms) {
+    Pending* free_slot = nullptr;
+    Pending* oldest = &slots_[0];
+    for (Pending& slot : slots_) {
+        if (!slot.in_use) {
+            free_slot = free_slot ? free_slot : &slot;
+            continue;
+        }
+        if (slot.message_id == message_id && slot.sender == sender) {
+            return slot;
+        }
+        if (!oldest->in_use || slot.started_ms < oldest->started_ms) {
+            oldest = &slot;
+        }
+    }
+    if (free_slot == nullptr) {
+        release(*oldest, false);
+        free_slot = oldest;
+    }
+    free_slot->in_use = true;
+    free_slot->sender.assign(sender);
+    free_slot->message_id = message_id;
+    free_slot->total = 0;
+    free_slot->received = 0;
+    free_slot->started_ms = now_ms;
+    free_slot->ranges.clear();
+    ++pending_;
+    return *free_slot;
+}
+
+std::string_view Reassembler::add(std::string_view sender, const Fragment& fragment,
+                                  int64_t now_ms) {
+    Pending& slot = slotFor(sender, fragment.message_id, now_ms);
+    if (slot.total == 0) {
+        slot.total = fragment.total;
+        slot.data.assign(fragment.total, '\0');
+    } else if (slot.total != fragment.total) {
+        release(slot, false);
+        return {};
+    }
+
+    uint32_t begin = fragment.offset;
+    uint32_t end = begin + static_cast<uint32_t>(fragment.chunk.size());
+    std::memcpy(slot.data.data() + begin, fragment.chunk.data(), fragment.chunk.size());
+
+    // Merge [begin, end) into the sorted, disjoint list of received ranges.
+    std::vector<std::pair<uint32_t, uint32_t>>& ranges = slot.ranges;
+    auto at = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(begin, begin));
+    if (at != ranges.begin() && std::prev(at)->second >= begin) {
+        --at;
+    }
+    uint32_t merged_begin = begin;
+    uint32_t merged_end = end;
+    uint32_t covered = 0;
+    auto last = at;
+    while (last != ranges.end() && last->first <= end) {
+        merged_begin = std::min(merged_begin, last->first);
+        merged_end = std::max(merged_end, last->second);
+        covered += last->second - last->first;
+        ++last;
+    }
+    at = ranges.erase(at, last);
+    ranges.insert(at, {merged_begin, merged_end});
+    slot.received += (merged_end - merged_begin) - covered;
+
+    if (slot.received < slot.total) {
+        return {};
+    }
+    complete_.swap(slot.data);
+    release(slot, true);
+    return complete_;
+}
+
+void Reassembler::expire(int64_t now_ms) {
+    if (pending_ == 0) {
+        return;
+    }
+    for (Pending& slot : slots_) {
+        if (slot.in_use && now_ms - slot.started_ms >= kTimeoutMs) {
+            release(slot, false);
+        }
+    }
+}
+
+void Reassembler::release(Pending& slot, bool completed) {
+    slot.in_use = false;
+    --pending_;
+    if (!completed) {
+        ++dropped_;
+    }
+}
+
+std::size_t Reassembler::pending() const {
+    return pending_;
+}
+
+uint64_t Reassembler::dropped() const {
+    return dropped_;
+}
@@ -0,0 +1,25 @@
+#include "HistoryRing.h"
+#include <cstring>
+
+HistoryRing::HistoryRing(std::size_t capacity, std::size_t slot_size)
+    : capacity_(capacity),
+      slot_size_(slot_size),
+      storage_(capacity * slot_size),
+      lengths_(capacity) {}
+
+void HistoryRing::push(std::string_view datagram) {
+    if (capacity_ == 0 || datagram.size() > slot_size_) {
+        return;
+    }
+
+    std::memcpy(storage_.data() + head_ * slot_size_, datagram.data(), datagram.size());
+    lengths_[head_] = datagram.size();
+    head_ = (head_ + 1) % capacity_;
+    if (count_ < capacity_) {
+        ++count_;
+    }
+}
+
+std::size_t HistoryRing::size() const {
+    return count_;
+}
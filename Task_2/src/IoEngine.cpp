@@ -0,0 +1,54 @@
+#include "IoEngine.h"
+#include "UringEngine.h"
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+constexpr std::size_t kRecvBatchSize = 32;
+constexpr std::size_t kSendBatchSize = 64;
+}
+
+std::unique_ptr<IoEngine> IoEngine::create(IoBackend backend, int sockfd) {
+    if (backend == IoBackend::Uring) {
+        try {
+            return std::make_unique<UringEngine>(sockfd);
+        } catch (const std::exception& ex) {
+            std::cerr << "[SERVER] io_uring unavailable (" << ex.what()
+                      << "), using sockets" << std::endl;
+        }
+    }
+    return std::make_unique<SocketEngine>(sockfd, kRecvBatchSize, kSendBatchSize);
+}
+
+SocketEngine::SocketEngine(int sockfd, std::size_t recv_capacity, std::size_t send_capacity)
+    : sockfd_(sockfd), recv_batch_(recv_capacity), send_batch_(send_capacity) {}
+
+int SocketEngine::receive() {
+    ++syscalls_;
+    int count = recv_batch_.receive(sockfd_);
+    if (count > 0) {
+        operations_ += static_cast<uint64_t>(count);
+    }
+    return count;
+}
+
+std::string_view SocketEngine::data(std::size_t index) const {
+    return recv_batch_.data(index);
+}
+
+const sockaddr_in& SocketEngine::source(std::size_t index) const {
+    return recv_batch_.source(index);
+}
+
+void SocketEngine::send(std::string_view datagram, const sockaddr_in& dest) {
+    uint64_t before = send_batch_.calls();
+    send_batch_.add(sockfd_, datagram, dest);
+    syscalls_ += send_batch_.calls() - before;
+    ++operations_;
+}
+
+void SocketEngine::flush() {
+    uint64_t before = send_batch_.calls();
+    send_batch_.flush(sockfd_);
+    syscalls_ += send_batch_.calls() - before;
+}
@@ -0,0 +1,228 @@
+#include "LoadGenerator.h"
+#include "MessageView.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr auto kHeartbeatInterval = std::chrono::seconds(5);
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+// Consumes one space-separated field from rest.
+std::string_view nextToken(std::string_view& rest) {
+    std::size_t pos = rest.find(' ');
+    std::string_view token = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return token;
+}
+
+double percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    std::size_t index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+} // namespace
+
+std::string LoadReport::toJson(const LoadOptions& options) const {
+    std::vector<int64_t> sorted = latencies_ns;
+    std::sort(sorted.begin(), sorted.end());
+    double loss = expected == 0 ? 0.0
+        : 1.0 - static_cast<double>(received) / static_cast<double>(expected);
+
+    std::ostringstream out;
+    out << "{\n"
+        << "  \"config\": {\"clients\": " << options.clients
+        << ", \"sockets\": " << options.sockets
+        << ", \"room_size\": " << options.room_size
+        << ", \"rate\": " << options.rate
+        << ", \"duration_sec\": " << options.duration_sec << "},\n"
+        << "  \"sent\": " << sent << ",\n"
+        << "  \"send_rate\": " << (elapsed_sec > 0 ? static_cast<double>(sent) / elapsed_sec : 0.0) << ",\n"
+        << "  \"expected_deliveries\": " << expected << ",\n"
+        << "  \"received_deliveries\": " << received << ",\n"
+        << "  \"loss_ratio\": " << std::max(loss, 0.0) << ",\n"
+        << "  \"latency_us\": {"
+        << "\"p50\": " << percentile(sorted, 0.50)
+        << ", \"p90\": " << percentile(sorted, 0.90)
+        << ", \"p99\": " << percentile(sorted, 0.99)
+        << ", \"p999\": " << percentile(sorted, 0.999)
+        << ", \"max\": " << (sorted.empty() ? 0.0 : static_cast<double>(sorted.back()) / 1000.0)
+        << "}\n"
+        << "}";
+    return out.str();
+}
+
+LoadGenerator::LoadGenerator(const LoadOptions& options) : options_(options) {
+    if (options_.clients <= 0 || options_.sockets <= 0 || options_.room_size <= 0) {
+        throw std::invalid_argument("clients, sockets and room size must be positive");
+    }
+
+    server_addr_.sin_family = AF_INET;
+    server_addr_.sin_port = htons(options_.server_port);
+    if (inet_pton(AF_INET, options_.server_ip.c_str(), &server_addr_.sin_addr) <= 0) {
+        throw std::runtime_error("Invalid server IP address");
+    }
+
+    for (int i = 0; i < options_.sockets; ++i) {
+        int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to create socket");
+        }
+        int rcvbuf = 8 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval timeout{0, 100 * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockfds_.push_back(fd);
+    }
+
+    // Unique per run so rooms and history from earlier runs are never counted.
+    run_tag_ = std::to_string(::getpid()) + "_" + std::to_string(nowNs() % 1000000);
+}
+
+LoadGenerator::~LoadGenerator() {
+    for (int fd : sockfds_) {
+        ::close(fd);
+    }
+}
+
+std::string LoadGenerator::userName(int client) const {
+    return "lg" + run_tag_ + "_u" + std::to_string(client);
+}
+
+std::string LoadGenerator::roomName(int client) const {
+    return "lg" + run_tag_ + "_r" + std::to_string(client / options_.room_size);
+}
+
+int LoadGenerator::roomMembers(int client) const {
+    int first = (client / options_.room_size) * options_.room_size;
+    return std::min(options_.room_size, options_.clients - first);
+}
+
+void LoadGenerator::sendTo(int client, const std::string& data) {
+    int fd = sockfds_[client % sockfds_.size()];
+    sendto(fd, data.data(), data.size(), 0,
+           reinterpret_cast<const sockaddr*>(&server_addr_), sizeof(server_addr_));
+}
+
+void LoadGenerator::joinAll() {
+    for (int client = 0; client < options_.clients; ++client) {
+        sendTo(client, "JOIN|" + userName(client) + "|" + roomName(client));
+        if (client % 256 == 255) {
+            // Keep the server receive queue from overflowing during setup.
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+}
+
+void LoadGenerator::leaveAll() {
+    for (int client = 0; client < options_.clients; ++client) {
+        sendTo(client, "LEAVE|" + userName(client) + "|" + roomName(client));
+    }
+}
+
+void LoadGenerator::receiverLoop(int sockfd, uint64_t& received, std::vector<int64_t>& latencies) {
+    char buffer[kMaxDatagram];
+    while (receiving_) {
+        ssize_t len = recv(sockfd, buffer, sizeof(buffer), 0);
+        if (len <= 0) {
+            continue;
+        }
+        int64_t now = nowNs();
+
+        std::string_view data(buffer, static_cast<std::size_t>(len));
+        forEachRecord(data, [&](std::string_view record) {
+            MessageView msg = MessageView::parse(record);
+            if (msg.type != MessageType::Chat) {
+                return;
+            }
+            std::string_view rest = msg.content;
+            if (nextToken(rest) != "LG" || nextToken(rest) != run_tag_) {
+                return;
+            }
+            nextToken(rest);   // sequence number
+            std::string_view stamp = nextToken(rest);
+            int64_t sent_ns = 0;
+            std::from_chars(stamp.data(), stamp.data() + stamp.size(), sent_ns);
+
+            ++received;
+            latencies.push_back(now - sent_ns);
+        });
+    }
+}
+
+LoadReport LoadGenerator::run() {
+    LoadReport report;
+    joinAll();
+
+    std::size_t socket_count = sockfds_.size();
+    std::vector<uint64_t> received(socket_count, 0);
+    std::vector<std::vector<int64_t>> latencies(socket_count);
+    uint64_t expected_total = static_cast<uint64_t>(options_.rate) * options_.duration_sec;
+    for (auto& samples : latencies) {
+        samples.reserve(expected_total * options_.room_size / socket_count + 1024);
+    }
+
+    receiving_ = true;
+    std::vector<std::thread> receivers;
+    for (std::size_t i = 0; i < socket_count; ++i) {
+        receivers.emplace_back(&LoadGenerator::receiverLoop, this, sockfds_[i],
+                               std::ref(received[i]), std::ref(latencies[i]));
+    }
+
+    auto interval = std::chrono::nanoseconds(1000000000LL / std::max(options_.rate, 1));
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::seconds(options_.duration_sec);
+    auto next_send = start;
+    auto next_heartbeat = start + kHeartbeatInterval;
+    int client = 0;
+    while (Clock::now() < deadline) {
+        std::this_thread::sleep_until(next_send);
+        if (Clock::now() >= next_heartbeat) {
+            // Keep quiet users from being evicted by the server's idle timeout.
+            for (int user = 0; user < options_.clients; ++user) {
+                sendTo(user, "PING|" + userName(user) + "|" + roomName(user));
+            }
+            next_heartbeat += kHeartbeatInterval;
+        }
+        std::string data = "CHAT|" + userName(client) + "|" + roomName(client) +
+                           "|LG " + run_tag_ + " " + std::to_string(report.sent) +
+                           " " + std::to_string(nowNs());
+        sendTo(client, data);
+        ++report.sent;
+        report.expected += static_cast<uint64_t>(roomMembers(client));
+        client = (client + 1) % options_.clients;
+        next_send += interval;
+    }
+    report.elapsed_sec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(options_.drain_ms));
+    receiving_ = false;
+    for (auto& receiver : receivers) {
+        receiver.join();
+    }
+    leaveAll();
+
+    for (std::size_t i = 0; i < socket_count; ++i) {
+        report.received += received[i];
+        report.latencies_ns.insert(report.latencies_ns.end(),
+                                   latencies[i].begin(), latencies[i].end());
+    }
+    return report;
+}
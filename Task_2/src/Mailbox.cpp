@@ -0,0 +1,51 @@
+#include "Mailbox.h"
+
+Mailbox::Mailbox(std::size_t capacity_bytes)
+    : capacity_(capacity_bytes),
+      mask_(capacity_bytes - 1),
+      buffer_(std::make_unique<char[]>(capacity_bytes)) {}
+
+bool Mailbox::push(MailKind kind, uint8_t origin, const sockaddr_in& addr,
+                   std::string_view name, std::string_view payload) {
+    std::size_t length = sizeof(Header) + name.size() + payload.size();
+    std::size_t size = (length + kAlign - 1) & ~(kAlign - 1);
+    if (size > capacity_ / 2 || name.size() > UINT16_MAX) {
+        return false;
+    }
+
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t offset = tail & mask_;
+    std::size_t contiguous = capacity_ - offset;
+    // A record never wraps: the rest of the ring becomes padding instead.
+    std::size_t needed = size + (contiguous < size ? contiguous : 0);
+    if (tail + needed - cached_head_ > capacity_) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (tail + needed - cached_head_ > capacity_) {
+            return false;
+        }
+    }
+
+    if (contiguous < size) {
+        Header pad{};
+        pad.size = static_cast<uint32_t>(contiguous);
+        pad.kind = MailKind::Pad;
+        // Records are kAlign-aligned, so at least the header prefix fits.
+        std::memcpy(buffer_.get() + offset, &pad, kPrefixSize);
+        tail += contiguous;
+        offset = 0;
+    }
+
+    Header header{};
+    header.size = static_cast<uint32_t>(size);
+    header.kind = kind;
+    header.origin = origin;
+    header.name_length = static_cast<uint16_t>(name.size());
+    header.payload_length = static_cast<uint32_t>(payload.size());
+    header.addr = addr;
+    char* at = buffer_.get() + offset;
+    std::memcpy(at, &header, sizeof(header));
+    std::memcpy(at + sizeof(header), name.data(), name.size());
+    std::memcpy(at + sizeof(header) + name.size(), payload.data(), payload.size());
+    tail_.store(tail + size, std::memory_order_release);
+    return true;
+}
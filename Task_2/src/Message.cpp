@@ -10,10 +10,14 @@ Message::Message(const std::string& type, const std::string& username,
 Message::~Message() = default; 
 
 std::string Message::serialize() const {
-    if (type == "JOIN" || type == "LEAVE") {
-        return type + "|" + username + "|" + room_name;
+    if (type == "JOIN" || type == "LEAVE" || type == "PING" || type == "GROUP") {
+        std::string data = type + "|" + username + "|" + room_name;
+        if (!content.empty()) {
+            data += "|" + content;
+        }
+        return data;
     }
-    else if (type == "CHAT") {
+    else if (type == "CHAT" || type == "DIRECT") {
         return type + "|" + username + "|" + room_name + "|" + content;
     }
     return "";
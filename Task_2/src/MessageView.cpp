@@ -0,0 +1,85 @@
+#include "MessageView.h"
+#include <cstring>
+
+namespace {
+
+std::string_view nextField(std::string_view& rest) {
+    std::size_t pos = rest.find('|');
+    std::string_view field = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return field;
+}
+
+MessageType typeFromName(std::string_view name) {
+    if (name == "CHAT") return MessageType::Chat;
+    if (name == "JOIN") return MessageType::Join;
+    if (name == "LEAVE") return MessageType::Leave;
+    if (name == "PING") return MessageType::Ping;
+    if (name == "GROUP") return MessageType::Group;
+    if (name == "DIRECT") return MessageType::Direct;
+    if (name == "FRAG") return MessageType::Fragment;
+    return MessageType::Unknown;
+}
+
+bool separates(std::string_view text) {
+    return text.find(kRecordSeparator) != std::string_view::npos;
+}
+
+char* append(char* out, std::string_view text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+} // namespace
+
+MessageView MessageView::parse(std::string_view data) {
+    MessageView msg;
+    std::size_t separator = data.find('|');
+    if (separator == std::string_view::npos || separates(data)) {
+        return msg;
+    }
+
+    std::string_view rest = data;
+    msg.type = typeFromName(nextField(rest));
+    msg.username = nextField(rest);
+    msg.room_name = nextField(rest);
+    // Content is the remainder, so it may itself contain '|'. For JOIN it
+    // carries session options such as "reliable".
+    msg.content = rest;
+    return msg;
+}
+
+std::size_t MessageView::encodeChat(char* out, std::size_t capacity,
+                                    std::string_view username,
+                                    std::string_view content) {
+    constexpr std::string_view prefix = "CHAT|";
+    constexpr std::string_view separator = "||";
+    std::size_t length = prefix.size() + username.size() + separator.size() + content.size();
+    if (length > capacity || separates(username) || separates(content)) {
+        return 0;
+    }
+
+    char* cursor = append(out, prefix);
+    cursor = append(cursor, username);
+    cursor = append(cursor, separator);
+    append(cursor, content);
+    return length;
+}
+
+std::size_t MessageView::encodeDirect(char* out, std::size_t capacity,
+                                      std::string_view from, std::string_view to,
+                                      std::string_view content) {
+    constexpr std::string_view prefix = "DIRECT|";
+    std::size_t length = prefix.size() + from.size() + 1 + to.size() + 1 + content.size();
+    if (length > capacity || separates(from) || separates(to) || separates(content)) {
+        return 0;
+    }
+
+    char* cursor = append(out, prefix);
+    cursor = append(cursor, from);
+    *cursor++ = '|';
+    cursor = append(cursor, to);
+    *cursor++ = '|';
+    append(cursor, content);
+    return length;
+}
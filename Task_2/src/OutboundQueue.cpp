@@ -0,0 +1,38 @@
+#include "OutboundQueue.h"
+#include "MessageView.h"
+#include <cstring>
+
+bool OutboundQueue::append(std::string_view record, std::size_t limit) {
+    std::size_t needed = length_ + (records_ > 0 ? 1 : 0) + record.size();
+    if (needed > limit) {
+        return false;
+    }
+    if (buffer_.size() < limit) {
+        buffer_.resize(limit);
+    }
+
+    if (records_ > 0) {
+        buffer_[length_++] = kRecordSeparator;
+    }
+    std::memcpy(buffer_.data() + length_, record.data(), record.size());
+    length_ += record.size();
+    ++records_;
+    return true;
+}
+
+bool OutboundQueue::empty() const {
+    return records_ == 0;
+}
+
+std::size_t OutboundQueue::records() const {
+    return records_;
+}
+
+std::string_view OutboundQueue::datagram() const {
+    return {buffer_.data(), length_};
+}
+
+void OutboundQueue::clear() {
+    length_ = 0;
+    records_ = 0;
+}
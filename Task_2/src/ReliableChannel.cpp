@@ -0,0 +1,224 @@
+#include "ReliableChannel.h"
+#include "MessageView.h"
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+std::string_view nextField(std::string_view& rest) {
+    std::size_t pos = rest.find('|');
+    std::string_view field = rest.substr(0, pos);
+    rest = (pos == std::string_view::npos) ? std::string_view{} : rest.substr(pos + 1);
+    return field;
+}
+
+template <typename T>
+bool parseNumber(std::string_view text, T& value, int base = 10) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// Appends text, number or raw bytes; cursor becomes nullptr once end is hit.
+class FrameWriter {
+public:
+    FrameWriter(char* out, std::size_t capacity) : cursor_(out), begin_(out), end_(out + capacity) {}
+
+    FrameWriter& text(std::string_view value) {
+        if (cursor_ == nullptr || static_cast<std::size_t>(end_ - cursor_) < value.size()) {
+            cursor_ = nullptr;
+            return *this;
+        }
+        std::memcpy(cursor_, value.data(), value.size());
+        cursor_ += value.size();
+        return *this;
+    }
+
+    template <typename T>
+    FrameWriter& number(T value, int base = 10) {
+        if (cursor_ == nullptr) {
+            return *this;
+        }
+        auto result = std::to_chars(cursor_, end_, value, base);
+        cursor_ = result.ec == std::errc() ? result.ptr : nullptr;
+        return *this;
+    }
+
+    [[nodiscard]] std::size_t length() const {
+        return cursor_ == nullptr ? 0 : static_cast<std::size_t>(cursor_ - begin_);
+    }
+
+private:
+    char* cursor_;
+    char* begin_;
+    char* end_;
+};
+
+} // namespace
+
+ReliableFrame ReliableFrame::parse(std::string_view datagram) {
+    ReliableFrame frame;
+    frame.inner = datagram;
+
+    std::string_view rest = datagram;
+    std::string_view tag = nextField(rest);
+    if (tag == "R") {
+        if (parseNumber(nextField(rest), frame.seq)) {
+            frame.kind = FrameKind::Data;
+            frame.inner = rest;
+        }
+    } else if (tag == "ACK") {
+        frame.username = nextField(rest);
+        if (parseNumber(nextField(rest), frame.seq) && parseNumber(nextField(rest), frame.value, 16)) {
+            frame.kind = FrameKind::Ack;
+        }
+    } else if (tag == "NACK") {
+        frame.username = nextField(rest);
+        if (parseNumber(nextField(rest), frame.seq) && parseNumber(nextField(rest), frame.value)) {
+            frame.kind = FrameKind::Nack;
+        }
+    }
+    return frame;
+}
+
+std::size_t ReliableFrame::encodeAck(char* out, std::size_t capacity,
+                                     std::string_view username,
+                                     uint32_t cum, uint64_t mask) {
+    return FrameWriter(out, capacity)
+        .text("ACK|").text(username).text("|").number(cum).text("|").number(mask, 16)
+        .length();
+}
+
+std::size_t ReliableFrame::encodeNack(char* out, std::size_t capacity,
+                                      std::string_view username,
+                                      uint32_t first, uint32_t count) {
+    return FrameWriter(out, capacity)
+        .text("NACK|").text(username).text("|").number(first).text("|").number(count)
+        .length();
+}
+
+ReliableChannel::ReliableChannel() : storage_(kWindow * kMaxDatagram) {}
+
+bool ReliableChannel::fits(std::string_view inner) {
+    return inner.size() + kMaxReliableHeader <= kMaxDatagram;
+}
+
+std::string_view ReliableChannel::wrap(std::string_view inner, int64_t now_ms) {
+    if (!queued_.empty() || slots_[next_seq_ % kWindow].in_use) {
+        if (queued_.size() < kMaxQueued) {
+            queued_.emplace_back(inner);
+        } else {
+            ++abandoned_;
+        }
+        return {};
+    }
+    return store(inner, now_ms);
+}
+
+std::string_view ReliableChannel::store(std::string_view inner, int64_t now_ms) {
+    uint32_t seq = next_seq_++;
+    std::size_t index = seq % kWindow;
+    Slot& slot = slots_[index];
+    std::size_t length = FrameWriter(storage_.data() + index * kMaxDatagram, kMaxDatagram)
+        .text("R|").number(seq).text("|").text(inner)
+        .length();
+    slot.seq = seq;
+    slot.length = static_cast<uint32_t>(length);
+    slot.last_send_ms = now_ms;
+    slot.retries = 0;
+    slot.in_use = true;
+    ++in_flight_;
+    return frame(slot);
+}
+
+void ReliableChannel::onAck(uint32_t cum, uint64_t mask) {
+    for (Slot& slot : slots_) {
+        if (!slot.in_use) {
+            continue;
+        }
+        int64_t distance = static_cast<int64_t>(slot.seq) - static_cast<int64_t>(cum) - 2;
+        if (distance < -1 || (distance >= 0 && distance < 64 && ((mask >> distance) & 1U))) {
+            release(slot);
+        }
+    }
+}
+
+bool ReliableChannel::accept(uint32_t seq, uint32_t& gap_first, uint32_t& gap_count) {
+    gap_first = 0;
+    gap_count = 0;
+    if (seq <= recv_cum_) {
+        ++duplicates_;
+        return false;
+    }
+
+    if (seq > recv_highest_ + 1) {
+        gap_first = recv_highest_ + 1 > recv_cum_ + 1 ? recv_highest_ + 1 : recv_cum_ + 1;
+        gap_count = seq - gap_first;
+    }
+    if (seq > recv_highest_) {
+        recv_highest_ = seq;
+    }
+
+    if (seq > recv_cum_ + 65) {
+        // Too far ahead: treat the oldest missing seqs as lost, so that seq
+        // lands on the last bit of the mask. Seqs already received past the
+        // new recv_cum_ are folded in as usual.
+        uint32_t shift = seq - recv_cum_ - 65;
+        recv_mask_ = shift > 64 ? 0 : recv_mask_ >> (shift - 1);
+        recv_cum_ += shift;
+        advanceCum();
+    }
+    if (seq == recv_cum_ + 1) {
+        recv_cum_ = seq;
+        advanceCum();
+        return true;
+    }
+
+    uint32_t offset = seq - recv_cum_ - 2;
+    if ((recv_mask_ >> offset) & 1U) {
+        ++duplicates_;
+        return false;
+    }
+    recv_mask_ |= uint64_t{1} << offset;
+    return true;
+}
+
+// Called with bit 0 of recv_mask_ standing for recv_cum_ + 1: moves
+// recv_cum_ past the received run that follows it and realigns the mask.
+void ReliableChannel::advanceCum() {
+    while (recv_mask_ & 1U) {
+        recv_mask_ >>= 1;
+        ++recv_cum_;
+    }
+    recv_mask_ >>= 1;
+}
+
+std::size_t ReliableChannel::encodeAck(char* out, std::size_t capacity,
+                                       std::string_view username) const {
+    return ReliableFrame::encodeAck(out, capacity, username, recv_cum_, recv_mask_);
+}
+
+bool ReliableChannel::hasInFlight() const {
+    return in_flight_ > 0 || !queued_.empty();
+}
+
+uint64_t ReliableChannel::retransmits() const {
+    return retransmits_;
+}
+
+uint64_t ReliableChannel::abandoned() const {
+    return abandoned_;
+}
+
+uint64_t ReliableChannel::duplicates() const {
+    return duplicates_;
+}
+
+std::string_view ReliableChannel::frame(const Slot& slot) const {
+    std::size_t index = static_cast<std::size_t>(&slot - slots_);
+    return {storage_.data() + index * kMaxDatagram, slot.length};
+}
+
+void ReliableChannel::release(Slot& slot) {
+    slot.in_use = false;
+    --in_flight_;
+}
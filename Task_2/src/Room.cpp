@@ -1,48 +1,121 @@
 #include "Room.h"
-#include <algorithm>
+#include "MessageView.h"
 
-UserInfo::UserInfo(const std::string& user, const std::string& ip_addr, int port_num)
-    : username(user), ip(ip_addr), port(port_num) {}
+UserInfo::UserInfo(uint32_t id, const sockaddr_in& address, bool via_multicast)
+    : user_id(id), addr(address), multicast(via_multicast) {}
 
 bool UserInfo::operator==(const UserInfo& other) const {
-    return username == other.username;
+    return user_id == other.user_id;
 }
 
-Room::Room() : room_name_("") {}
-
-Room::Room(const std::string& name) : room_name_(name) {}
+Room::Room(uint32_t id, std::string_view name, std::size_t history_size)
+    : room_id_(id), room_name_(name), history_(history_size, kMaxDatagram) {}
 
 Room::~Room() = default;
 
-void Room::addUser(const std::string& username, const std::string& ip, int port) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    
-    for (const auto& member : members_) {
-        if (member.username == username) {
-            return; 
+namespace {
+uint32_t indexHash(uint32_t user_id) {
+    return user_id * 2654435761u;
+}
+}
+
+// Position of user_id in index_, or of the free entry where it would go.
+std::size_t Room::probe(uint32_t user_id) const {
+    std::size_t mask = index_.size() - 1;
+    std::size_t pos = indexHash(user_id) & mask;
+    while (index_[pos].user_id != kNoSlot && index_[pos].user_id != user_id) {
+        pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+void Room::rebuildIndex(std::size_t capacity) {
+    index_.assign(capacity, IndexEntry{});
+    for (std::size_t slot = 0; slot < members_.size(); ++slot) {
+        index_[probe(members_[slot].user_id)] = {members_[slot].user_id, static_cast<uint32_t>(slot)};
+    }
+}
+
+// Backward-shift deletion: later entries of the probe run move up into the
+// hole, so lookups never need tombstones.
+void Room::eraseIndex(std::size_t pos) {
+    std::size_t mask = index_.size() - 1;
+    std::size_t hole = pos;
+    for (std::size_t next = (hole + 1) & mask; index_[next].user_id != kNoSlot; next = (next + 1) & mask) {
+        std::size_t home = indexHash(index_[next].user_id) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index_[hole] = index_[next];
+            hole = next;
+        }
+    }
+    index_[hole] = IndexEntry{};
+}
+
+bool Room::addUser(uint32_t user_id, const sockaddr_in& addr, bool multicast) {
+    if (index_.size() < 2 * (members_.size() + 1)) {
+        rebuildIndex(index_.empty() ? 8 : 2 * index_.size());
+    }
+    std::size_t pos = probe(user_id);
+    if (index_[pos].user_id == user_id) {
+        UserInfo& member = members_[index_[pos].slot];
+        if (member.multicast && !multicast) {
+            --multicast_count_;
+        } else if (!member.multicast && multicast) {
+            ++multicast_count_;
         }
+        member.multicast = multicast;
+        return false;
     }
-    
-    members_.emplace_back(username, ip, port);
+
+    index_[pos] = {user_id, static_cast<uint32_t>(members_.size())};
+    members_.emplace_back(user_id, addr, multicast);
+    if (multicast) {
+        ++multicast_count_;
+    }
+    return true;
 }
 
-void Room::removeUser(const std::string& username) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    
-    members_.erase(
-        std::remove_if(members_.begin(), members_.end(),
-            [&username](const UserInfo& user) {
-                return user.username == username;
-            }),
-        members_.end()
-    );
+void Room::removeUser(uint32_t user_id) {
+    if (index_.empty()) {
+        return;
+    }
+    std::size_t pos = probe(user_id);
+    if (index_[pos].user_id != user_id) {
+        return;
+    }
+
+    uint32_t slot = index_[pos].slot;
+    if (members_[slot].multicast) {
+        --multicast_count_;
+    }
+    members_[slot] = members_.back();
+    members_.pop_back();
+    if (slot < members_.size()) {
+        index_[probe(members_[slot].user_id)].slot = slot;
+    }
+    eraseIndex(pos);
 }
 
-std::vector<UserInfo> Room::getMembers() {
-    std::lock_guard<std::mutex> lock(mtx_);
+bool Room::hasUser(uint32_t user_id) const {
+    return !index_.empty() && index_[probe(user_id)].user_id == user_id;
+}
+
+std::size_t Room::memberCount() const {
+    return members_.size();
+}
+
+std::vector<UserInfo> Room::getMembers() const {
     return members_; 
 }
 
+uint32_t Room::getId() const {
+    return room_id_;
+}
+
 std::string Room::getName() const {
     return room_name_;
 }
+
+void Room::recordMessage(std::string_view datagram) {
+    history_.push(datagram);
+}
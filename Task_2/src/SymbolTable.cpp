@@ -0,0 +1,41 @@
+#include "SymbolTable.h"
+
+uint32_t SymbolTable::intern(std::string_view name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    if (!free_.empty()) {
+        uint32_t id = free_.back();
+        free_.pop_back();
+        names_[id] = name;
+        ids_.emplace(std::string_view(names_[id]), id);
+        return id;
+    }
+    uint32_t id = static_cast<uint32_t>(names_.size());
+    const std::string& stored = names_.emplace_back(name);
+    ids_.emplace(std::string_view(stored), id);
+    return id;
+}
+
+void SymbolTable::release(uint32_t id) {
+    if (id >= names_.size() || ids_.erase(names_[id]) == 0) {
+        return;
+    }
+    names_[id].clear();
+    free_.push_back(id);
+}
+
+uint32_t SymbolTable::find(std::string_view name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kInvalidId : it->second;
+}
+
+std::string_view SymbolTable::name(uint32_t id) const {
+    return id < names_.size() ? std::string_view(names_[id]) : std::string_view{};
+}
+
+std::size_t SymbolTable::size() const {
+    return names_.size();
+}
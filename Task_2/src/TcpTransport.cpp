@@ -0,0 +1,292 @@
+#include "TcpTransport.h"
+#include <cerrno>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+void encodeLength(char* out, uint32_t length) {
+    out[0] = static_cast<char>((length >> 24) & 0xFF);
+    out[1] = static_cast<char>((length >> 16) & 0xFF);
+    out[2] = static_cast<char>((length >> 8) & 0xFF);
+    out[3] = static_cast<char>(length & 0xFF);
+}
+
+uint32_t decodeLength(const char* in) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(in);
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+} // namespace
+
+TcpTransport::TcpTransport(int port, int epoll_fd)
+    : epoll_fd_(epoll_fd), pool_(kTcpHeaderSize + kMaxTcpFrame) {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("Failed to create TCP socket");
+    }
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0) {
+        ::close(listen_fd_);
+        throw std::runtime_error("Failed to listen on TCP port");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+}
+
+TcpTransport::~TcpTransport() {
+    for (std::size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd].open) {
+            ::close(static_cast<int>(fd));
+        }
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+    }
+}
+
+int TcpTransport::listenFd() const {
+    return listen_fd_;
+}
+
+void TcpTransport::acceptAll() {
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t peer_len = sizeof(peer);
+        int fd = accept4(listen_fd_, reinterpret_cast<struct sockaddr*>(&peer), &peer_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN ends the edge; anything else (e.g. EMFILE) waits for the next one.
+            return;
+        }
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        if (static_cast<std::size_t>(fd) >= connections_.size()) {
+            connections_.resize(static_cast<std::size_t>(fd) + 1);
+        }
+        Connection& conn = connections_[fd];
+        conn = Connection{};
+        conn.open = true;
+        conn.peer = peer;
+        ++open_count_;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void TcpTransport::onEvent(int fd, uint32_t events, TcpHandler& handler) {
+    if (static_cast<std::size_t>(fd) >= connections_.size() || !connections_[fd].open) {
+        return;
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        markClosing(fd);
+        return;
+    }
+    if (events & EPOLLIN) {
+        onReadable(fd, handler);
+    }
+    if (events & EPOLLOUT) {
+        onWritable(fd);
+    }
+}
+
+void TcpTransport::onReadable(int fd, TcpHandler& handler) {
+    Connection& conn = connections_[fd];
+    if (conn.closing) {
+        return;
+    }
+    char* buffer = conn.read_buffer != nullptr ? conn.read_buffer : pool_.acquire();
+    std::size_t length = conn.read_length;
+    bool failed = false;
+
+    // Edge-triggered: keep reading until the kernel buffer is empty.
+    while (true) {
+        ssize_t n = ::read(fd, buffer + length, pool_.chunkSize() - length);
+        if (n > 0) {
+            length += static_cast<std::size_t>(n);
+            std::size_t offset = 0;
+            while (length - offset >= kTcpHeaderSize) {
+                uint32_t frame_length = decodeLength(buffer + offset);
+                if (frame_length > kMaxTcpFrame) {
+                    failed = true;
+                    break;
+                }
+                if (length - offset < kTcpHeaderSize + frame_length) {
+                    break;
+                }
+                handler.onTcpFrame(fd, std::string_view(buffer + offset + kTcpHeaderSize, frame_length));
+                offset += kTcpHeaderSize + frame_length;
+            }
+            if (failed) {
+                break;
+            }
+            std::memmove(buffer, buffer + offset, length - offset);
+            length -= offset;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        failed = true;   // orderly shutdown or hard error
+        break;
+    }
+
+    if (failed || length == 0) {
+        pool_.release(buffer);
+        conn.read_buffer = nullptr;
+        conn.read_length = 0;
+    } else {
+        conn.read_buffer = buffer;
+        conn.read_length = length;
+    }
+    if (failed) {
+        markClosing(fd);
+    }
+}
+
+void TcpTransport::onWritable(int fd) {
+    Connection& conn = connections_[fd];
+    while (conn.write_length > conn.write_offset) {
+        ssize_t n = ::write(fd, conn.write_buffer + conn.write_offset,
+                            conn.write_length - conn.write_offset);
+        if (n > 0) {
+            conn.write_offset += static_cast<std::size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        markClosing(fd);
+        return;
+    }
+    pool_.release(conn.write_buffer);
+    conn.write_buffer = nullptr;
+    conn.write_offset = 0;
+    conn.write_length = 0;
+}
+
+bool TcpTransport::send(int fd, std::string_view payload) {
+    if (static_cast<std::size_t>(fd) >= connections_.size() || payload.size() > kMaxTcpFrame) {
+        return false;
+    }
+    Connection& conn = connections_[fd];
+    if (!conn.open || conn.closing) {
+        return false;
+    }
+
+    char header[kTcpHeaderSize];
+    encodeLength(header, static_cast<uint32_t>(payload.size()));
+    if (conn.write_length > conn.write_offset) {
+        // Keep frame order behind the existing backlog.
+        return queue(conn, header, kTcpHeaderSize) && queue(conn, payload.data(), payload.size());
+    }
+
+    iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = kTcpHeaderSize;
+    iov[1].iov_base = const_cast<char*>(payload.data());
+    iov[1].iov_len = payload.size();
+    ssize_t n = ::writev(fd, iov, 2);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            markClosing(fd);
+            return false;
+        }
+        n = 0;
+    }
+
+    std::size_t written = static_cast<std::size_t>(n);
+    if (written >= kTcpHeaderSize + payload.size()) {
+        return true;
+    }
+    if (written < kTcpHeaderSize) {
+        queue(conn, header + written, kTcpHeaderSize - written);
+        written = 0;
+    } else {
+        written -= kTcpHeaderSize;
+    }
+    // A partially written frame must be completed, and the chunk always fits one frame.
+    return queue(conn, payload.data() + written, payload.size() - written);
+}
+
+bool TcpTransport::queue(Connection& conn, const char* data, std::size_t length) {
+    if (conn.write_buffer == nullptr) {
+        conn.write_buffer = pool_.acquire();
+        conn.write_offset = 0;
+        conn.write_length = 0;
+    }
+    if (pool_.chunkSize() - conn.write_length < length && conn.write_offset > 0) {
+        std::memmove(conn.write_buffer, conn.write_buffer + conn.write_offset,
+                     conn.write_length - conn.write_offset);
+        conn.write_length -= conn.write_offset;
+        conn.write_offset = 0;
+    }
+    if (pool_.chunkSize() - conn.write_length < length) {
+        return false;
+    }
+    std::memcpy(conn.write_buffer + conn.write_length, data, length);
+    conn.write_length += length;
+    return true;
+}
+
+void TcpTransport::bindUser(int fd, uint32_t user_id) {
+    if (static_cast<std::size_t>(fd) < connections_.size()) {
+        connections_[fd].user_id = user_id;
+    }
+}
+
+const sockaddr_in& TcpTransport::peer(int fd) const {
+    return connections_[fd].peer;
+}
+
+void TcpTransport::markClosing(int fd) {
+    Connection& conn = connections_[fd];
+    if (!conn.closing) {
+        conn.closing = true;
+        closing_.push_back(fd);
+    }
+}
+
+void TcpTransport::reapClosed(TcpHandler& handler) {
+    for (std::size_t i = 0; i < closing_.size(); ++i) {
+        int fd = closing_[i];
+        Connection& conn = connections_[fd];
+        handler.onTcpClosed(fd, conn.user_id);
+        pool_.release(conn.read_buffer);
+        pool_.release(conn.write_buffer);
+        conn = Connection{};
+        --open_count_;
+        ::close(fd);
+    }
+    closing_.clear();
+}
+
+std::size_t TcpTransport::connectionCount() const {
+    return open_count_;
+}
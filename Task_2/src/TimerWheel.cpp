@@ -0,0 +1,93 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(int64_t tick_ms, int64_t start_ms)
+    : tick_ms_(tick_ms > 0 ? tick_ms : 1),
+      start_ms_(start_ms),
+      heads_(kLevels * kSlots, kNil) {}
+
+void TimerWheel::schedule(uint32_t id, int64_t expire_ms) {
+    if (id >= nodes_.size()) {
+        nodes_.resize(id + 1);
+    }
+    if (nodes_[id].bucket != kNil) {
+        unlink(id);
+    }
+
+    // Round up so a timer never fires before its expiry time.
+    uint64_t tick = expire_ms <= start_ms_ ? 0
+        : static_cast<uint64_t>((expire_ms - start_ms_ + tick_ms_ - 1) / tick_ms_);
+    nodes_[id].expire_tick = tick > current_tick_ ? tick : current_tick_ + 1;
+    place(id);
+}
+
+void TimerWheel::cancel(uint32_t id) {
+    if (pending(id)) {
+        unlink(id);
+    }
+}
+
+bool TimerWheel::pending(uint32_t id) const {
+    return id < nodes_.size() && nodes_[id].bucket != kNil;
+}
+
+std::size_t TimerWheel::size() const {
+    return size_;
+}
+
+void TimerWheel::place(uint32_t id) {
+    Node& node = nodes_[id];
+    // Pick the lowest level whose higher-order bits match the current tick.
+    int level = 0;
+    while (level < kLevels - 1 &&
+           (node.expire_tick >> (kSlotBits * (level + 1))) != (current_tick_ >> (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    uint64_t slot = (node.expire_tick >> (kSlotBits * level)) & kSlotMask;
+    if (level == kLevels - 1 && (node.expire_tick >> (kSlotBits * level)) - (current_tick_ >> (kSlotBits * level)) >= kSlots) {
+        // Beyond the wheel's range: park in the last slot before wrapping.
+        slot = ((current_tick_ >> (kSlotBits * level)) + kSlots - 1) & kSlotMask;
+    }
+
+    uint32_t bucket = static_cast<uint32_t>(level * kSlots + slot);
+    node.bucket = bucket;
+    node.prev = kNil;
+    node.next = heads_[bucket];
+    if (node.next != kNil) {
+        nodes_[node.next].prev = id;
+    }
+    heads_[bucket] = id;
+    ++size_;
+}
+
+void TimerWheel::unlink(uint32_t id) {
+    Node& node = nodes_[id];
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.bucket] = node.next;
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = kNil;
+    node.next = kNil;
+    node.bucket = kNil;
+    --size_;
+}
+
+void TimerWheel::cascade(int level) {
+    if (level >= kLevels) {
+        return;
+    }
+    uint64_t slot = (current_tick_ >> (kSlotBits * level)) & kSlotMask;
+    if (slot == 0) {
+        cascade(level + 1);
+    }
+
+    uint32_t& head = heads_[level * kSlots + slot];
+    while (head != kNil) {
+        uint32_t id = head;
+        unlink(id);
+        place(id);
+    }
+}
@@ -0,0 +1,34 @@
+#include "TokenBucket.h"
+
+TokenBucket::TokenBucket(double rate_per_sec, double burst) {
+    configure(rate_per_sec, burst);
+}
+
+void TokenBucket::configure(double rate_per_sec, double burst) {
+    rate_per_ms_ = rate_per_sec / 1000.0;
+    burst_ = burst;
+    tokens_ = burst;
+    last_refill_ms_ = 0;
+}
+
+bool TokenBucket::consume(double cost, int64_t now_ms) {
+    if (rate_per_ms_ <= 0.0) {
+        return true;
+    }
+
+    if (last_refill_ms_ == 0) {
+        last_refill_ms_ = now_ms;
+    } else if (now_ms > last_refill_ms_) {
+        tokens_ += static_cast<double>(now_ms - last_refill_ms_) * rate_per_ms_;
+        if (tokens_ > burst_) {
+            tokens_ = burst_;
+        }
+        last_refill_ms_ = now_ms;
+    }
+
+    if (tokens_ < cost) {
+        return false;
+    }
+    tokens_ -= cost;
+    return true;
+}
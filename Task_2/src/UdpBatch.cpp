@@ -0,0 +1,77 @@
+#include "UdpBatch.h"
+
+RecvBatch::RecvBatch(std::size_t capacity)
+    : capacity_(capacity),
+      buffers_(capacity * kMaxDatagram),
+      iovs_(capacity),
+      addrs_(capacity),
+      msgs_(capacity) {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        iovs_[i].iov_base = buffers_.data() + i * kMaxDatagram;
+        iovs_[i].iov_len = kMaxDatagram;
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+    }
+}
+
+int RecvBatch::receive(int sockfd) {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs_[i].msg_len = 0;
+    }
+    return recvmmsg(sockfd, msgs_.data(), static_cast<unsigned int>(capacity_),
+                    MSG_WAITFORONE, nullptr);
+}
+
+std::string_view RecvBatch::data(std::size_t index) const {
+    return {buffers_.data() + index * kMaxDatagram, msgs_[index].msg_len};
+}
+
+const sockaddr_in& RecvBatch::source(std::size_t index) const {
+    return addrs_[index];
+}
+
+SendBatch::SendBatch(std::size_t capacity)
+    : capacity_(capacity), iovs_(capacity), addrs_(capacity), msgs_(capacity) {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+}
+
+void SendBatch::add(int sockfd, std::string_view datagram, const sockaddr_in& dest) {
+    if (count_ == capacity_) {
+        flush(sockfd);
+    }
+    iovs_[count_].iov_base = const_cast<char*>(datagram.data());
+    iovs_[count_].iov_len = datagram.size();
+    addrs_[count_] = dest;
+    ++count_;
+}
+
+void SendBatch::flush(int sockfd) {
+    std::size_t sent = 0;
+    while (sent < count_) {
+        int rc = sendmmsg(sockfd, msgs_.data() + sent,
+                          static_cast<unsigned int>(count_ - sent), 0);
+        ++calls_;
+        if (rc <= 0) {
+            // Skip the datagram that failed, as a failed sendto would.
+            ++sent;
+            continue;
+        }
+        sent += static_cast<std::size_t>(rc);
+    }
+    count_ = 0;
+}
+
+std::size_t SendBatch::pending() const {
+    return count_;
+}
+
+uint64_t SendBatch::calls() const {
+    return calls_;
+}
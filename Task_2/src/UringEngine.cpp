@@ -0,0 +1,368 @@
+#include "UringEngine.h"
+#include <linux/io_uring.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+constexpr unsigned kSqEntries = 256;
+constexpr unsigned kCqEntries = 1024;
+constexpr unsigned kRecvBuffers = 128;             // power of two, as the kernel requires
+constexpr std::size_t kRecvBufferSize = 2048;      // recvmsg_out + address + datagram
+constexpr std::size_t kSendSlots = 256;
+constexpr uint16_t kBufferGroup = 0;
+constexpr uint64_t kRecvTag = UINT64_MAX;
+constexpr uint64_t kCancelTag = UINT64_MAX - 1;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                                    nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+}
+
+UringEngine::UringEngine(int sockfd)
+    : sockfd_(sockfd),
+      recv_buffers_(kRecvBuffers * kRecvBufferSize),
+      slots_(kSendSlots),
+      slot_buffers_(kSendSlots * kMaxDatagram) {
+    try {
+        setupRing();
+        setupBufferRing();
+    } catch (...) {
+        release();
+        throw;
+    }
+
+    recv_msg_.msg_namelen = sizeof(sockaddr_in);
+    ready_.reserve(kRecvBuffers);
+    batch_.reserve(kRecvBuffers);
+    free_slots_.reserve(kSendSlots);
+    for (std::size_t i = 0; i < kSendSlots; ++i) {
+        SendSlot& slot = slots_[i];
+        std::memset(&slot.msg, 0, sizeof(slot.msg));
+        slot.iov.iov_base = slot_buffers_.data() + i * kMaxDatagram;
+        slot.msg.msg_iov = &slot.iov;
+        slot.msg.msg_iovlen = 1;
+        slot.msg.msg_name = &slot.dest;
+        slot.msg.msg_namelen = sizeof(sockaddr_in);
+        free_slots_.push_back(static_cast<uint32_t>(kSendSlots - 1 - i));
+    }
+
+    // Kernels without multishot RECVMSG fail it while it is submitted, so
+    // the completion is already there to reap.
+    armReceive();
+    if (submit(0) < 0) {
+        int error = errno;
+        release();
+        throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(error));
+    }
+    reap();
+    if (!recv_armed_) {
+        release();
+        throw std::runtime_error(std::string("multishot RECVMSG unsupported: ") +
+                                 std::strerror(recv_error_));
+    }
+}
+
+UringEngine::~UringEngine() {
+    // The kernel keeps writing into recv_buffers_ while the receive is armed,
+    // so cancel it and wait for its last completion before freeing them.
+    if (recv_armed_ && ring_fd_ >= 0) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = kRecvTag;
+        sqe->user_data = kCancelTag;
+        ++to_submit_;
+        while (recv_armed_ && submit(1) >= 0) {
+            reap();
+        }
+    }
+    release();
+}
+
+void UringEngine::setupRing() {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kCqEntries;
+    ring_fd_ = ioUringSetup(kSqEntries, &params);
+    if (ring_fd_ < 0) {
+        throw std::runtime_error("io_uring_setup failed");
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        throw std::runtime_error("Failed to map io_uring submission ring");
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            throw std::runtime_error("Failed to map io_uring completion ring");
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        throw std::runtime_error("Failed to map io_uring submission entries");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_flags_ = at<unsigned>(sq_ring_, params.sq_off.flags);
+    sq_array_ = at<unsigned>(sq_ring_, params.sq_off.array);
+    sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+    cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+}
+
+// Receive buffers are handed to the kernel through a provided-buffer ring,
+// so the multishot receive picks one per datagram without a round trip.
+void UringEngine::setupBufferRing() {
+    long page = sysconf(_SC_PAGESIZE);
+    std::size_t bytes = kRecvBuffers * sizeof(io_uring_buf);
+    buf_ring_size_ = (bytes + static_cast<std::size_t>(page) - 1) & ~(static_cast<std::size_t>(page) - 1);
+    void* memory = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Failed to allocate io_uring buffer ring");
+    }
+    // The ring tail overlays the reserved field of the first entry. The
+    // header's io_uring_buf_ring does not lay out that way under C++.
+    buf_ring_ = static_cast<io_uring_buf*>(memory);
+    buf_ring_tail_ = &buf_ring_[0].resv;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = kRecvBuffers;
+    reg.bgid = kBufferGroup;
+    if (ioUringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        throw std::runtime_error("Failed to register io_uring buffer ring");
+    }
+    for (unsigned i = 0; i < kRecvBuffers; ++i) {
+        recycle(static_cast<uint16_t>(i));
+    }
+    publishBuffers();
+}
+
+void UringEngine::release() {
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_ != nullptr) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    if (buf_ring_ != nullptr) {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+    }
+}
+
+io_uring_sqe* UringEngine::nextSqe() {
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        submit(0);
+    }
+    unsigned index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    return sqe;
+}
+
+int UringEngine::submit(unsigned wait_for) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int rc;
+    do {
+        ++syscalls_;
+        rc = ioUringEnter(ring_fd_, to_submit_, wait_for, flags);
+    } while (rc < 0 && errno == EINTR);
+    if (rc > 0) {
+        to_submit_ -= std::min(to_submit_, static_cast<unsigned>(rc));
+    }
+    return rc;
+}
+
+void UringEngine::reap() {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        if (cqe.user_data == kCancelTag) {
+            continue;
+        }
+        if (cqe.user_data != kRecvTag) {
+            free_slots_.push_back(static_cast<uint32_t>(cqe.user_data));
+            continue;
+        }
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+            recv_armed_ = false;
+            recv_error_ = cqe.res < 0 ? -cqe.res : 0;
+        }
+        if ((cqe.flags & IORING_CQE_F_BUFFER) == 0) {
+            continue;  // -ENOBUFS or a socket error; receive() re-arms
+        }
+        auto buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        std::size_t prefix = sizeof(io_uring_recvmsg_out) + recv_msg_.msg_namelen;
+        if (cqe.res < 0 || static_cast<std::size_t>(cqe.res) < prefix) {
+            recycle(buffer_id);
+            continue;
+        }
+        Received received{};
+        received.buffer_id = buffer_id;
+        received.length = static_cast<uint32_t>(static_cast<std::size_t>(cqe.res) - prefix);
+        std::memcpy(&received.source, bufferAt(buffer_id) + sizeof(io_uring_recvmsg_out),
+                    sizeof(received.source));
+        ready_.push_back(received);
+        ++operations_;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    publishBuffers();
+
+    if ((__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) != 0) {
+        // Completions that did not fit in the ring are flushed by the next enter.
+        ++syscalls_;
+        ioUringEnter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+    }
+}
+
+void UringEngine::armReceive() {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockfd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&recv_msg_);
+    sqe->len = 1;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = kRecvTag;
+    ++to_submit_;
+    recv_armed_ = true;
+}
+
+void UringEngine::recycle(uint16_t buffer_id) {
+    io_uring_buf& buf = buf_ring_[buf_tail_ & (kRecvBuffers - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(bufferAt(buffer_id));
+    buf.len = static_cast<uint32_t>(kRecvBufferSize);
+    buf.bid = buffer_id;
+    ++buf_tail_;
+}
+
+void UringEngine::publishBuffers() {
+    __atomic_store_n(buf_ring_tail_, buf_tail_, __ATOMIC_RELEASE);
+}
+
+const char* UringEngine::bufferAt(uint16_t buffer_id) const {
+    return recv_buffers_.data() + static_cast<std::size_t>(buffer_id) * kRecvBufferSize;
+}
+
+// Buffers of the previous batch go back to the kernel first, so the batch
+// handed out here stays valid until the next call. The receive is re-armed
+// only while the kernel has a buffer to fill; otherwise it would end with
+// -ENOBUFS straight away, and the next call re-arms it instead.
+int UringEngine::receive() {
+    for (const Received& received : batch_) {
+        recycle(received.buffer_id);
+    }
+    batch_.clear();
+    reap();
+    batch_.swap(ready_);
+    if (!recv_armed_ && batch_.size() < kRecvBuffers) {
+        armReceive();
+    }
+    if (to_submit_ > 0) {
+        submit(0);
+    }
+    return static_cast<int>(batch_.size());
+}
+
+std::string_view UringEngine::data(std::size_t index) const {
+    const Received& received = batch_[index];
+    std::size_t prefix = sizeof(io_uring_recvmsg_out) + recv_msg_.msg_namelen;
+    return {bufferAt(received.buffer_id) + prefix, received.length};
+}
+
+const sockaddr_in& UringEngine::source(std::size_t index) const {
+    return batch_[index].source;
+}
+
+void UringEngine::send(std::string_view datagram, const sockaddr_in& dest) {
+    if (datagram.size() > kMaxDatagram) {
+        return;
+    }
+    while (free_slots_.empty()) {
+        // Every slot is still owned by the kernel: wait for a completion.
+        if (submit(1) < 0) {
+            return;
+        }
+        reap();
+    }
+    uint32_t index = free_slots_.back();
+    free_slots_.pop_back();
+
+    SendSlot& slot = slots_[index];
+    std::memcpy(slot.iov.iov_base, datagram.data(), datagram.size());
+    slot.iov.iov_len = datagram.size();
+    slot.dest = dest;
+
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sockfd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+    sqe->len = 1;
+    sqe->user_data = index;
+    ++to_submit_;
+    ++operations_;
+}
+
+void UringEngine::flush() {
+    if (to_submit_ > 0) {
+        submit(0);
+    }
+}
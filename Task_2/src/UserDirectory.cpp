@@ -0,0 +1,108 @@
+#include "UserDirectory.h"
+
+UserDirectory::UserDirectory()
+    : chunks_(std::make_unique<std::atomic<Entry*>[]>(kMaxChunks)) {
+    for (uint32_t i = 0; i < kMaxChunks; ++i) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+UserDirectory::~UserDirectory() {
+    for (uint32_t i = 0; i < kMaxChunks; ++i) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Called with write_mutex_ held. The chunk is published with release order
+// so a reader that sees the pointer also sees its initialized entries.
+UserDirectory::Entry* UserDirectory::entryFor(uint32_t user_id) {
+    uint32_t chunk_index = user_id >> kChunkBits;
+    if (chunk_index >= kMaxChunks) {
+        return nullptr;
+    }
+    Entry* chunk = chunks_[chunk_index].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+        chunk = new Entry[kChunkSize];
+        chunks_[chunk_index].store(chunk, std::memory_order_release);
+    }
+    return &chunk[user_id & (kChunkSize - 1)];
+}
+
+void UserDirectory::write(Entry& entry, uint32_t ip, uint16_t port, int32_t tcp_fd, bool present) {
+    uint32_t seq = entry.seq.load(std::memory_order_relaxed);
+    entry.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.ip.store(ip, std::memory_order_relaxed);
+    entry.port.store(port, std::memory_order_relaxed);
+    entry.tcp_fd.store(tcp_fd, std::memory_order_relaxed);
+    entry.present.store(present, std::memory_order_relaxed);
+    entry.seq.store(seq + 2, std::memory_order_release);
+}
+
+UserDirectory::Entry* UserDirectory::existing(uint32_t user_id) const {
+    uint32_t chunk_index = user_id >> kChunkBits;
+    if (chunk_index >= kMaxChunks) {
+        return nullptr;
+    }
+    Entry* chunk = chunks_[chunk_index].load(std::memory_order_acquire);
+    return chunk == nullptr ? nullptr : &chunk[user_id & (kChunkSize - 1)];
+}
+
+void UserDirectory::retain(uint32_t user_id, const sockaddr_in& addr, int tcp_fd) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    Entry* entry = entryFor(user_id);
+    if (entry == nullptr) {
+        return;
+    }
+    if (entry->rooms++ == 0) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    write(*entry, addr.sin_addr.s_addr, addr.sin_port, tcp_fd, true);
+}
+
+void UserDirectory::refresh(uint32_t user_id, const sockaddr_in& addr, int tcp_fd) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    Entry* entry = existing(user_id);
+    if (entry != nullptr && entry->rooms > 0) {
+        write(*entry, addr.sin_addr.s_addr, addr.sin_port, tcp_fd, true);
+    }
+}
+
+bool UserDirectory::release(uint32_t user_id) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    Entry* entry = existing(user_id);
+    if (entry == nullptr || entry->rooms == 0 || --entry->rooms > 0) {
+        return false;
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    write(*entry, 0, 0, -1, false);
+    return true;
+}
+
+bool UserDirectory::lookup(uint32_t user_id, Endpoint& out) const {
+    const Entry* found = existing(user_id);
+    if (found == nullptr) {
+        return false;
+    }
+    const Entry& entry = *found;
+
+    uint32_t before;
+    uint32_t after;
+    bool present;
+    do {
+        before = entry.seq.load(std::memory_order_acquire);
+        present = entry.present.load(std::memory_order_relaxed);
+        out.addr.sin_addr.s_addr = entry.ip.load(std::memory_order_relaxed);
+        out.addr.sin_port = entry.port.load(std::memory_order_relaxed);
+        out.tcp_fd = entry.tcp_fd.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = entry.seq.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+    out.addr.sin_family = AF_INET;
+    return present;
+}
+
+std::size_t UserDirectory::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include <chrono>
 #include <sstream>
 
 std::vector<std::string> Utils::split(const std::string& str, char delimiter) {
@@ -23,3 +24,8 @@ std::string Utils::join(const std::vector<std::string>& vec, char delimiter) {
     }
     return result;
 }
+
+int64_t Utils::monotonicMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,98 @@
+#include "WorkerGroup.h"
+#include <mutex>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+constexpr std::size_t kMailboxBytes = 1 << 20;
+
+// FNV-1a, so every worker maps a room name to the same owner.
+uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+}
+
+WorkerGroup::WorkerGroup(uint32_t workers) : workers_(workers) {
+    if (workers_ == 0 || workers_ > UINT8_MAX) {
+        throw std::runtime_error("Invalid worker count");
+    }
+    mailboxes_.resize(static_cast<std::size_t>(workers_) * workers_);
+    for (uint32_t from = 0; from < workers_; ++from) {
+        for (uint32_t to = 0; to < workers_; ++to) {
+            if (from != to) {
+                mailboxes_[from * workers_ + to] = std::make_unique<Mailbox>(kMailboxBytes);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < workers_; ++i) {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            for (int open_fd : event_fds_) {
+                ::close(open_fd);
+            }
+            throw std::runtime_error("Failed to create eventfd");
+        }
+        event_fds_.push_back(fd);
+    }
+}
+
+WorkerGroup::~WorkerGroup() {
+    for (int fd : event_fds_) {
+        ::close(fd);
+    }
+}
+
+uint32_t WorkerGroup::size() const {
+    return workers_;
+}
+
+uint32_t WorkerGroup::ownerOf(std::string_view room_name) const {
+    return hashName(room_name) % workers_;
+}
+
+Mailbox& WorkerGroup::mailbox(uint32_t from, uint32_t to) {
+    return *mailboxes_[from * workers_ + to];
+}
+
+int WorkerGroup::eventFd(uint32_t worker) const {
+    return event_fds_[worker];
+}
+
+void WorkerGroup::wake(uint32_t worker) {
+    uint64_t one = 1;
+    ssize_t written = ::write(event_fds_[worker], &one, sizeof(one));
+    (void)written;  // EAGAIN means the counter is already non-zero
+}
+
+void WorkerGroup::retainUser(std::string_view name, const sockaddr_in& addr, int tcp_fd) {
+    std::unique_lock<std::shared_mutex> lock(users_mutex_);
+    directory_.retain(users_.intern(name), addr, tcp_fd);
+}
+
+void WorkerGroup::refreshUser(std::string_view name, const sockaddr_in& addr, int tcp_fd) {
+    std::unique_lock<std::shared_mutex> lock(users_mutex_);
+    uint32_t user_id = users_.find(name);
+    if (user_id != SymbolTable::kInvalidId) {
+        directory_.refresh(user_id, addr, tcp_fd);
+    }
+}
+
+void WorkerGroup::releaseUser(std::string_view name) {
+    std::unique_lock<std::shared_mutex> lock(users_mutex_);
+    uint32_t user_id = users_.find(name);
+    if (user_id != SymbolTable::kInvalidId && directory_.release(user_id)) {
+        users_.release(user_id);
+    }
+}
+
+bool WorkerGroup::lookupUser(std::string_view name, Endpoint& out) const {
+    std::shared_lock<std::shared_mutex> lock(users_mutex_);
+    uint32_t user_id = users_.find(name);
+    return user_id != SymbolTable::kInvalidId && directory_.lookup(user_id, out);
+}
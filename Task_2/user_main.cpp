@@ -3,14 +3,20 @@
 #include <cstdlib>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <server_ip> <server_port>" << std::endl;
+    ClientMode mode = ClientMode::Unicast;
+    if (argc == 4 && std::string(argv[3]) == "--reliable") {
+        mode = ClientMode::Reliable;
+    } else if (argc == 4 && std::string(argv[3]) == "--multicast") {
+        mode = ClientMode::Multicast;
+    } else if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> <server_port> [--reliable | --multicast]"
+                  << std::endl;
         return 1;
     }
     std::string server_ip = argv[1];
     int server_port = std::atoi(argv[2]);
     try {
-        ChatClient client(server_ip, server_port);
+        ChatClient client(server_ip, server_port, mode);
         client.run();
     } catch (const std::exception& ex) {
         std::cerr << "Client error: " << ex.what() << std::endl;